@@ -0,0 +1,122 @@
+/*
+  File: CaptureHistory.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+*/
+#include "CaptureHistory.h"
+
+/*
+  Constructor
+  @holdOff milliseconds after a capture during which the same pulse train is treated as a repeat of the same press,
+  it is timed from the last repeat so a button which is held down is reported as a single press
+*/
+CaptureHistory::CaptureHistory(unsigned int holdOff) :
+            holdOff(holdOff),
+            repeatCount(0),
+            evictedCount(0)
+{
+  for (byte i = 0; i < CAPTURE_HISTORY_SIZE; i++) _entries[i].index = -1;
+}
+
+/*
+  Gets the pulse trains which have been captured within the hold-off window, the next capture only
+  needs to be matched against these to find out if it is a repeat
+  @now the current millis()
+  @indexes out parameter, the indexes of the pulse trains in the library
+  @return the number of indexes, 0 if there have been no recent captures
+*/
+byte CaptureHistory::getRecentIndexes(unsigned long now, int (&indexes)[CAPTURE_HISTORY_SIZE])
+{
+  byte count = 0;
+  for (byte i = 0; i < CAPTURE_HISTORY_SIZE; i++) {
+    if (isRecent(_entries[i], now)) indexes[count++] = _entries[i].index;
+  }
+  return count;
+}
+
+/*
+  Records a matched pulse train
+  If the same pulse train was captured within the hold-off window the repeat count of that press is increased,
+  otherwise it is added as a new press, replacing an unused entry or the oldest one if the history is full.
+  @match the result of the match
+  @now millis() when the pulse train was captured
+  @return true if this is a new press, false if it is a repeat of a recent one
+*/
+bool CaptureHistory::record(const MatchResult &match, unsigned long now)
+{
+  CaptureHistoryEntry *oldest = NULL;
+  for (byte i = 0; i < CAPTURE_HISTORY_SIZE; i++) {
+    CaptureHistoryEntry &entry = _entries[i];
+    if (entry.index == match.index && isRecent(entry, now)) {
+      entry.lastSeen = now;
+      if (entry.repeatCount < 255) entry.repeatCount++;
+      repeatCount++;
+      return false;
+    }
+    if (entry.index < 0) {
+      if (!oldest || oldest->index >= 0) oldest = &entry;
+    } else if (!oldest || (oldest->index >= 0 && now - entry.lastSeen > now - oldest->lastSeen)) {
+      // compared as ages so it still works when millis() wraps around
+      oldest = &entry;
+    }
+  }
+  if (oldest->index >= 0) evictedCount++;
+  oldest->index = match.index;
+  strcpy(oldest->key, match.key);
+  oldest->lastSeen = now;
+  oldest->repeatCount = 1;
+  return true;
+}
+
+/*
+  @now the current millis()
+  @return true if there is a press whose hold-off window has ended, ready to be removed by removeExpired
+*/
+bool CaptureHistory::hasExpired(unsigned long now)
+{
+  for (byte i = 0; i < CAPTURE_HISTORY_SIZE; i++) {
+    if (_entries[i].index >= 0 && !isRecent(_entries[i], now)) return true;
+  }
+  return false;
+}
+
+/*
+  Removes a press whose hold-off window has ended so that its repeat count can be reported
+  @now the current millis()
+  @entry out parameter, a copy of the removed press
+  @return true if a press was removed, false if there are none which have expired
+*/
+bool CaptureHistory::removeExpired(unsigned long now, CaptureHistoryEntry *entry)
+{
+  for (byte i = 0; i < CAPTURE_HISTORY_SIZE; i++) {
+    if (_entries[i].index >= 0 && !isRecent(_entries[i], now)) {
+      *entry = _entries[i];
+      _entries[i].index = -1;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+  Prints the number of captures which were recognised as repeats
+  @port the serial port to use
+*/
+void CaptureHistory::printStats(HardwareSerial &port)
+{
+  port.print(F("repeats suppressed: ")); port.print(repeatCount);
+  port.print(F(" evicted: ")); port.println(evictedCount);
+}
+
+/*
+  Private: @return true if the entry is in use and was last captured within the hold-off window
+*/
+bool CaptureHistory::isRecent(const CaptureHistoryEntry &entry, unsigned long now)
+{
+  return entry.index >= 0 && now - entry.lastSeen <= holdOff;
+}
+
+// Destructor
+CaptureHistory::~CaptureHistory() {
+  // nothing to destruct here
+}
@@ -0,0 +1,57 @@
+/*
+  File: CaptureHistory.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Keeps a small history of the recently matched pulse trains so that the later repeats of the same
+  button press can be recognised and suppressed instead of being reported as another press.
+
+  Refer to cpp file for function descriptions and more info
+*/
+#ifndef CaptureHistory_h
+#define CaptureHistory_h
+
+#include "Arduino.h"
+#include "PulseTrainManager.h"
+
+// Number of recently matched pulse trains remembered, each entry uses 13 bytes of SRAM
+#define CAPTURE_HISTORY_SIZE 4
+
+/*
+  A recently matched pulse train
+  index: index of the pulse train in the library (as returned in MatchResult.index), -1 if the entry is unused
+  key: the key of the pulse train
+  lastSeen: millis() when the last repeat of the press was captured
+  repeatCount: number of times the press has been captured, including the first time
+*/
+struct CaptureHistoryEntry {
+  int index;
+  char key[6];
+  unsigned long lastSeen;
+  byte repeatCount;
+};
+typedef struct CaptureHistoryEntry CaptureHistoryEntry;
+
+class CaptureHistory
+{
+  public:
+    // Constructor
+    CaptureHistory(unsigned int holdOff);
+    byte getRecentIndexes(unsigned long now, int (&indexes)[CAPTURE_HISTORY_SIZE]);
+    bool record(const MatchResult &match, unsigned long now);
+    bool hasExpired(unsigned long now);
+    bool removeExpired(unsigned long now, CaptureHistoryEntry *entry);
+    void printStats(HardwareSerial &port);
+    unsigned int holdOff; // milliseconds after a capture during which the same pulse train is treated as a repeat
+    // Performance counters, kept since boot
+    unsigned int repeatCount; // captures recognised as a repeat of a recent press
+    unsigned int evictedCount; // presses removed before their repeat count was reported because the history was full
+    // Destructor
+    ~CaptureHistory();
+
+  private:
+    CaptureHistoryEntry _entries[CAPTURE_HISTORY_SIZE];
+    bool isRecent(const CaptureHistoryEntry &entry, unsigned long now);
+};
+
+#endif
@@ -28,6 +28,28 @@ inline void printMemoryInfo() {
   sout << F("DataSize: ") << dataSize() << F(" Bytes") << endl;
 }
 
+// Minimum length of the sync gap before a pulse train in microseconds, the receiver starts recording on a pulse this long
+#define SYNC_GAP_MIN_DURATION 5000
+
+/*
+  Returns the matching tolerance for a pulse (about 10% of the pulse length)
+  Uses shifts rather than a multiply and divide so it stays in 16bit arithmetic on an 8 bit mcu
+  (1/16 + 1/32 + 1/128 = 10.2%)
+*/
+inline int16_t pulseTolerance(int16_t pulse) {
+  uint16_t length = abs(pulse);
+  return (length >> 4) + (length >> 5) + (length >> 7);
+}
+
+/*
+  Returns the tighter matching tolerance used once a pulse has been rescaled by the drift tolerant matching (about 8.6%)
+  (1/16 + 1/64 + 1/128 = 8.6%)
+*/
+inline int16_t scaledPulseTolerance(int16_t pulse) {
+  uint16_t length = abs(pulse);
+  return (length >> 4) + (length >> 6) + (length >> 7);
+}
+
 /* 
   Macro for printing MemoryInfo
   Note that the Stack pointer will be affected by calling the functions which obtain the memory info
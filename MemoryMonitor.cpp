@@ -0,0 +1,157 @@
+/*
+  File: MemoryMonitor.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+*/
+#include "MemoryMonitor.h"
+
+// Provided by the linker and avr-libc's malloc
+extern uint8_t __data_start;
+extern uint8_t __heap_start;
+extern char *__brkval; // end of the heap, 0 until the first allocation
+
+/*
+  Paints the memory between the end of the static variables and the stack pointer with STACK_PAINT
+  Placed in the .init3 section so it runs straight after the stack pointer has been set up, before
+  the static variables are initialised and the constructors run. It is naked and never called,
+  the startup code falls through the .init sections in turn.
+*/
+void paintStack() __attribute__((naked, used, section(".init3")));
+void paintStack() {
+  uint8_t *p = &__heap_start;
+  while (p < (uint8_t*)SP) *p++ = STACK_PAINT;
+}
+
+// Constructor
+MemoryMonitor::MemoryMonitor() :
+            _maxHeapEnd((unsigned int)&__heap_start),
+            _minStackPointer(RAMEND),
+            _stackLow(RAMEND + 1),
+            _heapHigh((unsigned int)&__heap_start),
+            _measureTop(RAMEND)
+{}
+
+/*
+  Samples the end of the heap and the stack pointer, cheap enough to call on every pass of the main loop
+  The samples only see the state between tasks, the painted memory shows the peaks reached inside them
+*/
+void MemoryMonitor::update() {
+  unsigned int heapEnd = getHeapEnd();
+  if (heapEnd > _maxHeapEnd) _maxHeapEnd = heapEnd;
+  unsigned int stackPointer = SP;
+  if (stackPointer < _minStackPointer) _minStackPointer = stackPointer;
+}
+
+/*
+  @return the size of the static variables (.data and .bss) in bytes, fixed at compile time
+*/
+unsigned int MemoryMonitor::getStaticSize() {
+  return (unsigned int)&__heap_start - (unsigned int)&__data_start;
+}
+
+/*
+  @return the largest size the heap has reached since boot in bytes
+*/
+unsigned int MemoryMonitor::getMaxHeapSize() {
+  scan();
+  return _heapHigh - (unsigned int)&__heap_start;
+}
+
+/*
+  @return the deepest the stack has been since boot in bytes
+*/
+unsigned int MemoryMonitor::getMaxStackSize() {
+  scan();
+  return RAMEND + 1 - _stackLow;
+}
+
+/*
+  @return the number of free bytes between the end of the heap and the stack pointer now
+*/
+int MemoryMonitor::getFreeGap() {
+  return (int)SP - (int)getHeapEnd();
+}
+
+/*
+  @return the worst case number of free bytes between the heap and the stack since boot, the largest heap
+  and the deepest stack may not have happened at the same time so the actual gap may not have been this small
+*/
+int MemoryMonitor::getMinFreeGap() {
+  scan();
+  return (int)_stackLow - (int)_heapHigh;
+}
+
+/*
+  Starts measuring the stack used by a function, call endStackMeasure() after calling it
+  The peaks since boot are recorded first, then the free memory below the stack pointer is painted again
+  so the stack used from here on can be found. Takes about 1ms.
+*/
+void MemoryMonitor::beginStackMeasure() {
+  scan();
+  _measureTop = SP;
+  uint8_t *p = (uint8_t*)getHeapEnd();
+  while (p < (uint8_t*)_measureTop) *p++ = STACK_PAINT;
+}
+
+/*
+  @return the number of bytes of stack used since beginStackMeasure() was called, including any interrupts which ran meanwhile
+*/
+unsigned int MemoryMonitor::endStackMeasure() {
+  const uint8_t *bottom = (const uint8_t*)getHeapEnd();
+  const uint8_t *p = (const uint8_t*)_measureTop;
+  byte run = 0;
+  while (p > bottom && run < STACK_PAINT_RUN) {
+    p--;
+    run = *p == STACK_PAINT ? run + 1 : 0;
+  }
+  return _measureTop - ((unsigned int)p + run);
+}
+
+/*
+  Prints the static size, the largest heap and the deepest stack since boot along with the free gap now and the worst case
+  @port the serial port to use
+*/
+void MemoryMonitor::printStats(HardwareSerial &port) {
+  port.print(F("ram static: ")); port.print(getStaticSize());
+  port.print(F(" heap max: ")); port.print(getMaxHeapSize());
+  port.print(F(" stack max: ")); port.print(getMaxStackSize());
+  port.print(F(" free now: ")); port.print(getFreeGap());
+  port.print(F(" min free: ")); port.println(getMinFreeGap());
+}
+
+/*
+  Private: @return the address of the end of the heap
+*/
+unsigned int MemoryMonitor::getHeapEnd() {
+  return __brkval ? (unsigned int)__brkval : (unsigned int)&__heap_start;
+}
+
+/*
+  Private: Finds the memory which has never been used since boot, the run of painted bytes between the heap and the stack
+  Scans down from the stack pointer until it finds STACK_PAINT_RUN painted bytes in a row, which is where the stack
+  has never reached, then carries on down to the end of the painted run, which is as far as the heap has been written.
+  The sampled heap end and stack pointer are included in case the painted bytes were never overwritten.
+  Takes about 1ms, only called when the results are asked for.
+*/
+void MemoryMonitor::scan() {
+  update();
+  const uint8_t *bottom = (const uint8_t*)_maxHeapEnd;
+  const uint8_t *p = (const uint8_t*)SP;
+  byte run = 0;
+  while (p > bottom && run < STACK_PAINT_RUN) {
+    p--;
+    run = *p == STACK_PAINT ? run + 1 : 0;
+  }
+  unsigned int stackLow = (unsigned int)p + run;
+  while (p > bottom && *(p - 1) == STACK_PAINT) p--;
+  unsigned int heapHigh = (unsigned int)p;
+  if (_minStackPointer + 1 < stackLow) stackLow = _minStackPointer + 1;
+  if (_maxHeapEnd > heapHigh) heapHigh = _maxHeapEnd;
+  if (stackLow < _stackLow) _stackLow = stackLow;
+  if (heapHigh > _heapHigh) _heapHigh = heapHigh;
+}
+
+// Destructor
+MemoryMonitor::~MemoryMonitor() {
+  // nothing to destruct here
+}
@@ -0,0 +1,51 @@
+/*
+  File: MemoryMonitor.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Tracks the worst case SRAM use since boot, so the sizes of the buffers (such as SAMPLESIZE) can be chosen
+  from the measured headroom between the heap and the stack rather than by trial and error.
+  The free memory between the heap and the stack is painted with a known value at boot (before the
+  constructors run), the painted bytes which have since been overwritten show how deep the stack has been.
+
+  Refer to cpp file for function descriptions and more info
+*/
+#ifndef MemoryMonitor_h
+#define MemoryMonitor_h
+
+#include "Arduino.h"
+
+// Value the free memory is painted with at boot
+#define STACK_PAINT 0xC5
+// Number of consecutive painted bytes taken as the start of the memory which has never been used,
+// so a painted value which happens to be left on the stack is not mistaken for it
+#define STACK_PAINT_RUN 16
+
+class MemoryMonitor
+{
+  public:
+    // Constructor
+    MemoryMonitor();
+    void update();
+    unsigned int getStaticSize();
+    unsigned int getMaxHeapSize();
+    unsigned int getMaxStackSize();
+    int getFreeGap();
+    int getMinFreeGap();
+    void beginStackMeasure();
+    unsigned int endStackMeasure();
+    void printStats(HardwareSerial &port);
+    // Destructor
+    ~MemoryMonitor();
+
+  private:
+    unsigned int _maxHeapEnd; // highest end of the heap seen by update()
+    unsigned int _minStackPointer; // lowest stack pointer seen by update()
+    unsigned int _stackLow; // lowest address the stack has reached, found by scan()
+    unsigned int _heapHigh; // highest address the heap has reached, found by scan()
+    unsigned int _measureTop; // stack pointer when beginStackMeasure() was called
+    unsigned int getHeapEnd();
+    void scan();
+};
+
+#endif
@@ -0,0 +1,195 @@
+/*
+  File: OutputQueue.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+*/
+#include "OutputQueue.h"
+
+/*
+  Constructor
+  @size the size of the buffer in bytes, allocated once and kept for the lifetime of the program
+  @overflowPort when the lane is full the buffered bytes and the new byte are written straight to this port
+  (blocking until the serial port has room), NULL to drop the rest of the line instead
+  @queue the queue the lane belongs to
+*/
+OutputLane::OutputLane(byte size, HardwareSerial *overflowPort, OutputQueue *queue) :
+            droppedCount(0),
+            overflowCount(0),
+            _size(size),
+            _head(0),
+            _count(0),
+            _lineLength(0),
+            _dropping(false),
+            _overflowPort(overflowPort),
+            _queue(queue)
+{
+  _buffer = (char*)malloc(_size);
+}
+
+/*
+  Adds a byte to the lane, called by the Print functions
+  When a lane without an overflow port is full the whole line is dropped: the part of it still in the lane is
+  removed and the rest is dropped as it is written, only the end of line is kept if the start of it has been sent.
+  @c the byte to add
+  @return 1 if the byte was added or written, 0 if it was dropped
+*/
+size_t OutputLane::write(uint8_t c) {
+  if (_dropping) {
+    if (c != '\n') return 0;
+    _dropping = false;
+    // the start of the line has been sent, it still needs to be ended (the lane has room as the rest was removed)
+    if (_lineLength == 0) return 0;
+  } else if (_count >= _size || !_buffer) {
+    if (!_overflowPort) {
+      droppedCount++;
+      if (_lineLength <= _count) {
+        _count -= _lineLength;
+        _lineLength = 0;
+      } else {
+        _count = 0; // the start of the line has been sent already, _lineLength is left set to end it
+      }
+      if (c == '\n') {
+        if (_lineLength == 0) return 0;
+      } else {
+        _dropping = true;
+        return 0;
+      }
+    } else {
+      // a debug line part way through being sent is finished first and the buffered bytes go next so that the order is kept
+      if (_queue) _queue->finishLine();
+      while (_count > 0) {
+        _overflowPort->write((uint8_t)read());
+        overflowCount++;
+      }
+      overflowCount++;
+      return _overflowPort->write(c);
+    }
+  }
+  byte index = _head + _count;
+  if (index >= _size) index -= _size;
+  _buffer[index] = c;
+  _count++;
+  if (c == '\n') {
+    _lineLength = 0;
+  } else if (_lineLength < 255) {
+    _lineLength++; // a longer line has had its start sent already
+  }
+  return 1;
+}
+
+/*
+  @return the number of bytes waiting to be sent
+*/
+byte OutputLane::length() {
+  return _count;
+}
+
+/*
+  @return the number of bytes that can be added before the lane is full
+*/
+byte OutputLane::space() {
+  return _buffer ? _size - _count : 0;
+}
+
+/*
+  Removes the oldest byte from the lane
+  @return the byte, -1 if the lane is empty
+*/
+int OutputLane::read() {
+  if (_count == 0) return -1;
+  byte c = _buffer[_head];
+  if (++_head >= _size) _head = 0;
+  _count--;
+  return c;
+}
+
+// Destructor
+OutputLane::~OutputLane() {
+  free(_buffer);
+}
+
+/*
+  Constructor
+  @port the serial port the output is sent to
+  @eventSize the size of the event lane in bytes
+  @debugSize the size of the debug lane in bytes, needs to hold the longest debug line
+*/
+OutputQueue::OutputQueue(HardwareSerial &port, byte eventSize, byte debugSize) :
+            event(eventSize, &port, this),
+            debug(debugSize, NULL, this),
+            _port(port),
+            _current(NULL)
+{}
+
+/*
+  @return true if there is output waiting to be sent
+*/
+bool OutputQueue::pending() {
+  return event.length() > 0 || debug.length() > 0;
+}
+
+/*
+  Moves as much of the output as the serial port's transmit buffer has room for, without blocking
+  The serial port's own data register empty interrupt then sends it in the background.
+  Lines are not split between the lanes, the event lane goes first at the start of each line
+  so an event is only ever held up by the rest of the debug line being sent.
+*/
+void OutputQueue::drain() {
+  int room = _port.availableForWrite();
+  while (room > 0) {
+    if (!_current) {
+      if (event.length() > 0) {
+        _current = &event;
+      } else if (debug.length() > 0) {
+        _current = &debug;
+      } else {
+        break;
+      }
+    }
+    int c = _current->read();
+    if (c < 0) {
+      // the rest of the line was dropped or has not been written yet, let the other lane go
+      _current = NULL;
+      continue;
+    }
+    _port.write((uint8_t)c);
+    room--;
+    if (c == '\n') _current = NULL;
+  }
+}
+
+/*
+  Sends the rest of the line part way through being sent, blocking until the serial port has room for it
+  Used before the event lane writes straight to the serial port so an event is not put in the middle of a debug line
+*/
+void OutputQueue::finishLine() {
+  while (_current) {
+    int c = _current->read();
+    if (c < 0) break; // the rest of the line has not been written yet
+    _port.write((uint8_t)c);
+    if (c == '\n') break;
+  }
+  _current = NULL;
+}
+
+/*
+  Sends all of the waiting output, blocking until the serial port has room for it
+  Used before printing straight to the serial port so the output stays in order
+*/
+void OutputQueue::flush() {
+  while (pending()) drain();
+}
+
+/*
+  Prints the number of lines dropped from the debug lane and bytes written straight to the port from the event lane
+  @port the serial port to use
+*/
+void OutputQueue::printStats(HardwareSerial &port) {
+  port.print(F("output debug dropped: ")); port.print(debug.droppedCount);
+  port.print(F(" event overflow: ")); port.println(event.overflowCount);
+}
+
+// Destructor
+OutputQueue::~OutputQueue() {
+  // nothing to destruct here
+}
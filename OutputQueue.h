@@ -0,0 +1,68 @@
+/*
+  File: OutputQueue.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Buffers the serial output so that printing never holds up the main loop
+  Events (KEY:, OK etc.) and debug output are written to separate lanes, events are sent first
+  and are never dropped, debug output is dropped a line at a time if its lane is full.
+
+  Refer to cpp file for function descriptions and more info
+*/
+#ifndef OutputQueue_h
+#define OutputQueue_h
+
+#include "Arduino.h"
+
+class OutputQueue;
+
+/*
+  A lane of the OutputQueue, a ring buffer written to using the Print functions (or the Streaming << operator)
+*/
+class OutputLane : public Print
+{
+  public:
+    // Constructor
+    OutputLane(byte size, HardwareSerial *overflowPort, OutputQueue *queue);
+    virtual size_t write(uint8_t c);
+    using Print::write;
+    byte length();
+    byte space();
+    int read();
+    unsigned int droppedCount; // lines dropped because the lane was full
+    unsigned int overflowCount; // bytes written straight to the port because the lane was full
+    // Destructor
+    ~OutputLane();
+
+  private:
+    char *_buffer;
+    const byte _size;
+    byte _head; // index of the oldest byte
+    byte _count;
+    byte _lineLength; // number of bytes written since the last end of line
+    bool _dropping; // the rest of the current line is dropped
+    HardwareSerial *_overflowPort; // bytes are written straight to this port when the lane is full, NULL to drop them
+    OutputQueue *_queue; // the queue the lane belongs to
+};
+
+class OutputQueue
+{
+  public:
+    // Constructor
+    OutputQueue(HardwareSerial &port, byte eventSize, byte debugSize);
+    OutputLane event; // responses and events which must not be lost
+    OutputLane debug; // debug output which can be dropped
+    bool pending();
+    void drain();
+    void flush();
+    void printStats(HardwareSerial &port);
+    void finishLine();
+    // Destructor
+    ~OutputQueue();
+
+  private:
+    HardwareSerial &_port;
+    OutputLane *_current; // the lane part way through sending a line, NULL at the end of a line
+};
+
+#endif
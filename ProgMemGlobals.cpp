@@ -69,18 +69,22 @@ const int sizeOfInt = sizeof(int16_t);
   Create an array of PulseStructs populated with identifier keys, pulse train sizes and pointers to the above pulse trains
   This array of structs is stored in PROGMEM only, adding elements to it does not affect the amount of SRAM available
   The only SRAM used is by the variable itself which is just a pointer to the first element of the array stored in the Flash memory 
+ Each entry can end with a transmit profile, { repeatCount, preamble, repeatGap, device }, for devices which need more or
+ fewer repeats than the default or a different preamble or gap between the repeats (0 uses the default), eg.
+   { "ENG10", (sizeof pt_eng10)/sizeOfInt, (int16_t*)&pt_eng10, { 3, 0, 0, 0 } },
+ The keys of the same device share a device id so a queued command is replaced by a later one for that device.
  */
 const PulseTrainStruct pulseTrainArray[] PROGMEM = {
-  { "ENG10", (sizeof pt_eng10)/sizeOfInt, (int16_t*)&pt_eng10},
-  { "ENG11", (sizeof pt_eng11)/sizeOfInt, (int16_t*)&pt_eng11},
-  { "ENG20", (sizeof pt_eng20)/sizeOfInt, (int16_t*)&pt_eng20},
-  { "ENG21", (sizeof pt_eng21)/sizeOfInt, (int16_t*)&pt_eng21},
-  { "ENG30", (sizeof pt_eng30)/sizeOfInt, (int16_t*)&pt_eng30},
-  { "ENG31", (sizeof pt_eng31)/sizeOfInt, (int16_t*)&pt_eng31},
-  { "ENG40", (sizeof pt_eng40)/sizeOfInt, (int16_t*)&pt_eng40},
-  { "ENG41", (sizeof pt_eng41)/sizeOfInt, (int16_t*)&pt_eng41},
-  { "ENG00", (sizeof pt_eng00)/sizeOfInt, (int16_t*)&pt_eng00},
-  { "ENG01", (sizeof pt_eng01)/sizeOfInt, (int16_t*)&pt_eng01},
+  { "ENG10", (sizeof pt_eng10)/sizeOfInt, (int16_t*)&pt_eng10, { 0, 0, 0, 1 } },
+  { "ENG11", (sizeof pt_eng11)/sizeOfInt, (int16_t*)&pt_eng11, { 0, 0, 0, 1 } },
+  { "ENG20", (sizeof pt_eng20)/sizeOfInt, (int16_t*)&pt_eng20, { 0, 0, 0, 2 } },
+  { "ENG21", (sizeof pt_eng21)/sizeOfInt, (int16_t*)&pt_eng21, { 0, 0, 0, 2 } },
+  { "ENG30", (sizeof pt_eng30)/sizeOfInt, (int16_t*)&pt_eng30, { 0, 0, 0, 3 } },
+  { "ENG31", (sizeof pt_eng31)/sizeOfInt, (int16_t*)&pt_eng31, { 0, 0, 0, 3 } },
+  { "ENG40", (sizeof pt_eng40)/sizeOfInt, (int16_t*)&pt_eng40, { 0, 0, 0, 4 } },
+  { "ENG41", (sizeof pt_eng41)/sizeOfInt, (int16_t*)&pt_eng41, { 0, 0, 0, 4 } },
+  { "ENG00", (sizeof pt_eng00)/sizeOfInt, (int16_t*)&pt_eng00, { 0, 0, 0, 5 } },
+  { "ENG01", (sizeof pt_eng01)/sizeOfInt, (int16_t*)&pt_eng01, { 0, 0, 0, 5 } },
 
   { "EGG10", (sizeof pt_egg10)/sizeOfInt, (int16_t*)&pt_egg10},
   { "EGG10", (sizeof pt_egg11)/sizeOfInt, (int16_t*)&pt_egg11},
@@ -96,6 +100,23 @@ const PulseTrainStruct pulseTrainArray[] PROGMEM = {
 // grab the resulting size of the array and store it for future use
 int pulseTrainArraySize = (sizeof pulseTrainArray) / sizeof(PulseTrainStruct);
 
+/*
+   Pulse trains which fit the two symbol PWM model are stored bit-packed (21 bytes plus one byte for every 8 bits
+   instead of around 110 for a 24 bit pulse train), run tools/build_pwm_library.py to list the pulse trains above
+   which fit, along with the declarations to paste in here in place of the empty library below.
+   They are matched by decoding the captured pulse train into bits and are rebuilt from their symbol timings when transmitted.
+   None of the pulse trains above fit cleanly as they have been modified, an entry is stored as:
+   const uint8_t pwm_key01[] PROGMEM = { bits... };
+   const PwmPulseTrainStruct pwmPulseTrains[] PROGMEM = {
+     { "KEY01", syncGap, shortPulse, longPulse, bitCount, pwm_key01 },
+   };
+   const PwmPulseTrainStruct *pwmPulseTrainArray = pwmPulseTrains;
+   int pwmPulseTrainArraySize = (sizeof pwmPulseTrains) / sizeof(PwmPulseTrainStruct);
+   each entry can be followed by a transmit profile in the same way as the entries above
+*/
+const PwmPulseTrainStruct *pwmPulseTrainArray = NULL;
+int pwmPulseTrainArraySize = 0;
+
 // Notes:
 // Storing the pulse trains in PROGMEM is trading off performance and added complexity for much lower memory usage.
 // Performance is not critical here but memory usage is when we only have 2kb to play with.
@@ -12,16 +12,36 @@
 #ifndef ProgMemGlobals_h
   #define ProgMemGlobals_h
 
+/*
+  How a pulse train is transmitted, 0 in any field uses the default
+  repeatCount: number of times the pulse train is sent (defaults to repeatCount in RFController.ino)
+  preamble: high pulse sent before the first repeat to settle the receiving device's AGC in microseconds
+  (defaults to initialPulse in RFController.ino)
+  repeatGap: low gap sent in place of the sync pulse (index 0) before each repeat in microseconds
+  (defaults to the pulse train's own sync pulse)
+  device: pulse trains with the same non-zero device id control the same device (eg. its on and off keys),
+  a command waiting in the transmit queue is replaced by a later command for the same device (0: never replaced)
+*/
+  struct TransmitProfile {
+    uint8_t repeatCount;
+    int16_t preamble;
+    int16_t repeatGap;
+    uint8_t device;
+  };
+  typedef struct TransmitProfile TransmitProfile;
+
 /*
   Struct to hold the pulseTrain data
   key: 3 character identifier for the pulsetrain
   pulseTrainSize: size of the pulsetrain (number of elements in the array)
   pulseTrain: the array of int16_t representing the pulse lengths in microseconds
+  profile: how the pulse train is transmitted, can be left out of the initialiser to use the defaults
 */
   struct PulseTrainStruct {
     char key[6];
     int pulseTrainSize;
     int16_t *pulseTrain;
+    TransmitProfile profile;
   };
   typedef struct PulseTrainStruct PulseTrainStruct;
 
@@ -29,4 +49,61 @@
   extern const PulseTrainStruct pulseTrainArray[] PROGMEM;
   extern int pulseTrainArraySize;
 
+/*
+  Bit-packed form of a two symbol PWM pulse train, used in place of PulseTrainStruct for the pulse trains that fit
+  A PWM pulse train is a sync gap followed by bitCount symbols of a high pulse and a low pulse and then a short high pulse,
+  a 1 is a long high pulse followed by a short low pulse and a 0 is a short high pulse followed by a long low pulse
+  key: 5 character identifier for the pulsetrain
+  syncGap: the sync gap (negative, the same as index 0 of a PulseTrainStruct pulse train)
+  shortPulse: the duration of the short pulses in microseconds
+  longPulse: the duration of the long pulses in microseconds
+  bitCount: the number of symbols (up to PWM_MAX_BITS)
+  bits: the symbols in (bitCount + 7) / 8 bytes stored in progmem, first symbol in the most significant bit of bits[0]
+  profile: how the pulse train is transmitted, can be left out of the initialiser to use the defaults
+  An entry takes 21 bytes on the AVR plus its bits (24 bytes for a 24 bit pulse train instead of around 110)
+*/
+  #define PWM_MAX_BITS 64
+  #define PWM_BITS_SIZE (PWM_MAX_BITS / 8)
+  struct PwmPulseTrainStruct {
+    char key[6];
+    int16_t syncGap;
+    int16_t shortPulse;
+    int16_t longPulse;
+    uint8_t bitCount;
+    const uint8_t *bits;
+    TransmitProfile profile;
+  };
+  typedef struct PwmPulseTrainStruct PwmPulseTrainStruct;
+
+  // Points to an array of PwmPulseTrainStruct in progmem, NULL if there are none
+  extern const PwmPulseTrainStruct *pwmPulseTrainArray;
+  extern int pwmPulseTrainArraySize;
+
+/*
+  Node of the prefix trie layout of pulseTrainArray, generated into ProgMemTrie.cpp by tools/build_pulse_trie.py
+  Each node matches a run of pulses, pulse trains sharing the same leading pulses share the same nodes
+  pulseStart: index of the first pulse of the run in pulseTriePulses
+  pulseCount: number of pulses in the run (0 for the root node)
+  childCount: number of child nodes, the children of a node are stored contiguously
+  firstChild: index of the first child node in pulseTrieNodes
+  entry: index in pulseTrainArray of the pulse train which ends at this node, -1 if none
+*/
+  struct PulseTrieNode {
+    uint16_t pulseStart;
+    uint8_t pulseCount;
+    uint8_t childCount;
+    uint16_t firstChild;
+    int16_t entry;
+  };
+  typedef struct PulseTrieNode PulseTrieNode;
+  // Maximum number of levels of nodes below the root, limits the stack used by PulseTrainManager::searchTrie (8 bytes per level)
+  #define PULSE_TRIE_MAX_DEPTH 12
+
+  // The prefix trie layout of pulseTrainArray (excluding the sync gaps), node 0 is the root
+  extern const int16_t pulseTriePulses[] PROGMEM;
+  extern const PulseTrieNode pulseTrieNodes[] PROGMEM;
+  extern const int pulseTrieNodeCount;
+  extern const int pulseTrieEntryCount;
+  extern const uint16_t pulseTrieChecksum; // checksum of the pulse trains the trie was generated from
+
 #endif
@@ -0,0 +1,98 @@
+/*
+   File: ProgMemTrie.cpp
+   Generated by tools/build_pulse_trie.py from ProgMemGlobals.cpp, do not edit by hand.
+
+   Prefix trie layout of the pulse trains in pulseTrainArray, stored in Flash (PROGMEM).
+   Used by PulseTrainManager::findPulseTrainTrie to match against all of the pulse trains in one traversal.
+   17 pulse trains, 30 nodes (7 levels deep), 724 pooled pulses: 1688 bytes (the raw pulse trains use 1700 bytes)
+*/
+
+#include "ProgMemGlobals.h"
+
+static_assert(7 <= PULSE_TRIE_MAX_DEPTH, "pulse trie too deep for PulseTrainManager::searchTrie, increase PULSE_TRIE_MAX_DEPTH");
+
+const int16_t pulseTriePulses[] PROGMEM = {
+  609,-202,609,-605,188,-605,188,-202,609,-202,609,-202,609,-202,609,-202,
+  188,-605,188,-605,188,-605,188,-605,188,-605,188,-202,188,-605,188,-605,
+  609,-202,609,-202,609,-202,188,-605,609,-202,188,-605,188,-605,188,-605,
+  188,-605,229,-216,229,-605,216,-202,216,-605,637,-202,637,-202,216,-605,
+  216,-605,609,-202,609,-202,216,-605,216,-605,609,-605,216,-605,216,-605,
+  609,-202,609,-202,216,-605,216,-605,609,-202,609,-216,216,-605,216,-216,
+  229,-605,609,-605,637,-202,216,-605,609,-202,216,-202,216,-605,609,-605,
+  609,-202,609,-202,216,-605,216,-605,216,-605,216,-605,216,-605,216,-202,
+  216,-202,216,-605,609,-202,609,-216,216,-605,609,-202,216,609,-605,609,
+  -605,637,-202,216,-605,637,-202,216,-202,609,-605,609,-605,609,-202,609,
+  -202,609,-605,216,-605,216,-605,216,-605,609,-605,609,-202,609,-202,216,
+  -605,216,-202,609,-202,609,-202,609,-202,216,-216,229,-605,637,-202,216,
+  -605,637,-202,609,-202,609,-605,216,-605,609,-202,609,-202,216,-605,216,
+  -605,609,-605,609,-605,216,-605,216,-202,609,-202,216,-605,216,-202,216,
+  -605,609,-216,609,-202,216,609,-605,637,-202,229,-605,637,-202,216,-202,
+  609,-605,609,-605,609,-202,609,-202,609,-605,216,-605,216,-605,216,-605,
+  216,-605,609,-202,216,-202,216,-605,216,-605,609,-202,609,-216,609,-202,
+  216,609,-605,637,-202,216,-605,637,-202,216,-202,609,-605,216,-605,609,
+  -202,609,-202,216,-605,609,-605,609,-605,216,-605,609,-605,609,-202,216,
+  -202,216,-605,216,-202,216,-202,609,-216,216,-605,216,-216,637,-202,229,
+  -605,637,-202,637,-202,216,-605,216,-605,637,-202,609,-202,216,-605,216,
+  -605,609,-605,216,-605,216,-605,609,-202,216,-202,216,-605,609,-605,216,
+  -605,216,-202,216,-605,216,-605,637,-202,216,-605,637,-202,216,-202,216,
+  -605,216,-605,609,-202,609,-202,609,-605,609,-605,609,-605,609,-605,216,
+  -605,609,-202,216,-202,216,-605,609,-202,609,-216,216,-605,216,-605,216,
+  511,-605,1388,-413,472,-1330,1388,-413,472,-605,1388,-413,472,-1330,472,-1330,
+  472,-1330,1388,-1330,472,-1330,1388,-442,1388,-442,1388,-442,472,-1330,472,-1330,
+  1388,-1330,472,-1330,472,-1330,472,-1330,472,637,-202,216,-605,637,-202,637,
+  -202,216,-605,216,-605,637,-202,609,-202,609,-605,609,-605,216,-605,609,
+  -605,216,-605,609,-202,609,-202,216,-605,609,-202,216,-605,609,-202,216,
+  -605,216,216,-202,216,-605,637,-202,216,-202,216,-605,609,-605,609,-202,
+  609,-202,216,-605,216,-605,216,-605,216,-605,216,-605,609,-202,609,-202,
+  216,-605,216,-605,216,-605,609,-216,609,-202,216,-925,888,-308,888,-308,
+  313,-925,888,-308,888,-308,281,-925,281,-925,888,-308,281,-925,281,-925,
+  888,-308,281,-925,281,-925,888,-324,888,-324,281,-925,888,-324,281,-925,
+  281,-925,281,-308,313,-308,888,-308,313,-925,888,-308,888,-308,281,-925,
+  281,-925,888,-308,281,-925,281,-925,888,-308,281,-925,281,-925,888,-308,
+  888,-308,888,-324,888,-324,281,-925,281,-925,281,-442,472,-1330,472,-1330,
+  472,-1330,1388,-442,472,-1330,1388,-442,472,-1330,472,-1330,1388,-442,1388,-442,
+  472,-1330,472,-1330,472,-1330,1388,-1330,472,-1330,472,-1330,472,-1330,472,-1330,
+  1388,-442,472,-1330,1388,-442,1388,-1330,1388,-1330,472,-1330,472,-1330,1388,-442,
+  1388,-442,1388,-1330,472,-1330,472,-413,472,-1330,472,-1330,472,-1330,1388,-442,
+  472,-1330,1388,-442,472,-1330,472,-1330,472,-1330,472,-1330,472,-1330,472,-1330,
+  1388,-442,1388,-442,472,472,-605,1388,-413,472,-1330,1388,-413,472,-605,1388,
+  313,-925,313,-925,313,-925,888,-308,888,511,-1330,1388,-413,511,-1330,1388,
+  -413,-605,229,-605,
+};
+
+// { pulseStart, pulseCount, childCount, firstChild, entry }
+const PulseTrieNode pulseTrieNodes[] PROGMEM = {
+  { 0, 0, 4, 1, -1 },
+  { 50, 1, 2, 5, -1 },
+  { 704, 9, 2, 7, -1 },
+  { 0, 49, 0, 0, 12 },  // LDB11
+  { 713, 8, 2, 9, -1 },
+  { 49, 2, 2, 11, -1 },
+  { 51, 2, 2, 13, -1 },
+  { 523, 40, 0, 0, 10 },  // EGG10
+  { 563, 40, 0, 0, 11 },  // EGG10
+  { 400, 41, 0, 0, 13 },  // BGFBA
+  { 693, 11, 3, 15, -1 },
+  { 51, 1, 2, 18, -1 },
+  { 721, 3, 2, 20, -1 },
+  { 49, 46, 0, 0, 2 },  // ENG20
+  { 95, 46, 0, 0, 9 },  // ENG01
+  { 603, 30, 0, 0, 14 },  // BGFBB
+  { 633, 30, 0, 0, 15 },  // BGFBC
+  { 663, 30, 0, 0, 16 },  // BGFBD
+  { 50, 1, 2, 22, -1 },
+  { 141, 45, 0, 0, 1 },  // ENG11
+  { 230, 43, 0, 0, 3 },  // ENG21
+  { 50, 1, 2, 24, -1 },
+  { 3, 1, 2, 26, -1 },
+  { 186, 44, 0, 0, 5 },  // ENG31
+  { 316, 42, 0, 0, 6 },  // ENG40
+  { 358, 42, 0, 0, 8 },  // ENG00
+  { 273, 43, 0, 0, 0 },  // ENG10
+  { 52, 2, 2, 28, -1 },
+  { 441, 41, 0, 0, 4 },  // ENG30
+  { 482, 41, 0, 0, 7 },  // ENG41
+};
+const int pulseTrieNodeCount = 30;
+const int pulseTrieEntryCount = 17; // must equal pulseTrainArraySize
+const uint16_t pulseTrieChecksum = 0x2CDC; // checksum of the pulse trains in pulseTrainArray
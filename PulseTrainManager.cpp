@@ -12,105 +12,621 @@ using namespace MemoryInfo;
 
 extern HardwareSerial &sout;
 
-// Constructor
-PulseTrainManager::PulseTrainManager() {}
+// Default Constructor, uses the pulseTrainArray and pwmPulseTrainArray stored in progmem
+PulseTrainManager::PulseTrainManager() :
+    PulseTrainManager(pulseTrainArray, pulseTrainArraySize, pwmPulseTrainArray, pwmPulseTrainArraySize) {}
+
+/*
+  Constructor
+  @library an array of PulseTrainStruct stored in progmem (the pulse trains it points to must also be in progmem)
+  @librarySize the number of elements in the library
+  @pwmLibrary an array of PwmPulseTrainStruct stored in progmem, NULL if there are no bit-packed pulse trains
+  @pwmLibrarySize the number of elements in the PWM library
+  Used by the host tools to match against other libraries, the firmware uses the default constructor
+*/
+PulseTrainManager::PulseTrainManager(const PulseTrainStruct *library, int librarySize,
+                                     const PwmPulseTrainStruct *pwmLibrary, int pwmLibrarySize) :
+            _library(library),
+            _librarySize(librarySize),
+            _pwmLibrary(pwmLibrary),
+            _pwmLibrarySize(pwmLibrary ? pwmLibrarySize : 0),
+            _maxMismatches(0), // every compared pulse must match, the same acceptance as before scoring was added
+            _driftTolerant(false),
+            _units(NULL),
+            _detectedUnit(0),
+            _matchDetected(NULL),
+            _matchIndex(librarySize + _pwmLibrarySize), // no search in progress
+            _bestIndex(-1),
+            _trieChecked(false),
+            _trieValid(false)
+{
+    memset(matchTimeHistogram, 0, sizeof(matchTimeHistogram));
+    // allocated once and kept for the lifetime of the program, 2 bytes per stored pulse train
+    keyMatchCounts = (unsigned int*)calloc(_librarySize + _pwmLibrarySize, sizeof(unsigned int));
+}
+
+// Upper limits (microseconds) of the match time histogram buckets, the last bucket has no limit
+static const unsigned int matchTimeLimits[MATCH_TIME_BUCKETS - 1] PROGMEM = { 1000, 2000, 5000, 10000, 20000, 50000 };
 
 
 /*
   Finds a matching pulsetrain from the pulseTrainArray
-  Some memory debug was required while writing this to check the heap usage etc.
   @param detectedPulseTrain the pulsetrain we want to find a match for
   @key out parameter, the key that was matched
   @return true if match was found
-
-  TODO: memory could be optimised further by comparing directly to progmem data rather than copying into RAM first.
-  Searching through and matching against 19 stored pulsetrains takes about 25ms,
-  so speed is not really an issue for the intended use.
 */
 bool PulseTrainManager::findPulseTrain(vector<int16_t> *detectedPulseTrain, char (&key)[6])
 {
+    MatchResult result;
+    if (findPulseTrain(detectedPulseTrain, &result)) {
+        strcpy(key, result.key);
+        return true;
+    }
+    return false;
+}
+
+/*
+  Finds the best matching pulsetrain from the pulseTrainArray
+  Every stored pulsetrain is scored against the detected pulsetrain rather than stopping at the
+  first one that matches, this prevents misidentification between near identical pulse trains
+  such as ENG11 and ENG21 which only differ in a few pulses.
+  The stored pulse trains are compared directly from progmem rather than being copied into RAM first.
+  Blocks until the search is complete, use beginMatch and continueMatch to search in time slices
+  @param detectedPulseTrain the pulsetrain we want to find a match for
+  @result out parameter, the key that was matched along with the match confidence and the runner-up margin
+  @return true if match was found
+*/
+bool PulseTrainManager::findPulseTrain(vector<int16_t> *detectedPulseTrain, MatchResult *result)
+{
+    beginMatch(detectedPulseTrain);
+    while (!continueMatch(0)) {}
+    return getMatchResult(result);
+}
+
+/*
+  Starts a search for the best matching pulsetrain which is carried out by calling continueMatch
+  @param detectedPulseTrain the pulsetrain we want to find a match for, must not be modified until the search is complete
+*/
+void PulseTrainManager::beginMatch(vector<int16_t> *detectedPulseTrain)
+{
+    _matchDetected = detectedPulseTrain;
+    _matchIndex = 0;
+    _matchTime = 0;
+    _bestIndex = -1;
+    _bestConfidence = 0;
+    _runnerUpConfidence = 0;
+    int detectedPulseTrainSize = (*detectedPulseTrain).size();
+    _detectedUnit = 0;
+    if (_driftTolerant && detectedPulseTrainSize > 1) {
+        // the last pulse is the radio silence
+        _detectedUnit = estimateUnit(&(*detectedPulseTrain)[0], detectedPulseTrainSize - 1, false);
+    }
+}
+
+/*
+  Continues the search started by beginMatch, scoring stored pulse trains until the time slice is used up
+  At least one stored pulse train is scored on each call so the search always makes progress
+  @maxTime the time slice in microseconds, 0 to complete the search in a single call
+  @return true when the search is complete
+*/
+bool PulseTrainManager::continueMatch(unsigned long maxTime)
+{
+    if (isMatchComplete()) return true;
     // Time this function's execution...
     unsigned long t1 = micros();
+    int detectedPulseTrainSize = (*_matchDetected).size();
+    const int16_t *detected = detectedPulseTrainSize > 0 ? &(*_matchDetected)[0] : NULL;
+    while (_matchIndex < _librarySize && detected)
+    {
+        byte confidence = scoreLibraryItem(detected, detectedPulseTrainSize, _matchIndex);
+        //sout << F("key: ") << _matchIndex << F(" confidence: ") << confidence << endl;
+        if (confidence > 0) recordCandidate(_matchIndex, confidence);
+        _matchIndex++;
+        if (maxTime > 0 && micros() - t1 >= maxTime) break;
+    }
+    // the PWM library is matched in one go once the library has been scored, it is much quicker
+    if (detected && _matchIndex == _librarySize) matchPwmPulseTrains(detected, detectedPulseTrainSize);
+    // an empty pulse train has nothing to compare, the search is complete straight away
+    if (!detected || _matchIndex >= _librarySize) _matchIndex = _librarySize + _pwmLibrarySize;
+    // only the time spent searching is recorded, not the time spent waiting between slices
+    _matchTime += micros() - t1;
+    if (!isMatchComplete()) return false;
+    // This takes ...... to search through a pulseTrainArraySize of 19 elements
+    //sout << F("time: ") << _matchTime << endl;
+    recordMatchTime(_matchTime);
+    if (_bestIndex > -1 && keyMatchCounts) keyMatchCounts[_bestIndex]++;
+    return true;
+}
+
+/*
+  @return true if there is no search in progress
+*/
+bool PulseTrainManager::isMatchComplete()
+{
+    return _matchIndex >= _librarySize + _pwmLibrarySize;
+}
+
+/*
+  Gets the result of the last completed search
+  @result out parameter, the key that was matched along with the match confidence and the runner-up margin
+  @return true if match was found
+*/
+bool PulseTrainManager::getMatchResult(MatchResult *result)
+{
+    if (_bestIndex < 0 || !isMatchComplete()) return false;
+    strcpy(result->key, _matchResult.key);
+    result->index = _bestIndex;
+    result->confidence = _bestConfidence;
+    result->margin = _bestConfidence - _runnerUpConfidence;
+    return true;
+}
+
+/*
+  Matches the detected pulse train against only some of the stored pulse trains, used to confirm that a
+  capture is another repeat of a recently matched pulse train without searching the whole library.
+  The PWM library is always matched in full (it is quick), so the result is false if a PWM pulse train
+  which was not asked for is a better match. Not time sliced and not recorded in the stats.
+  Only an exact match (confidence 100, no mismatched pulses or bits) is accepted whatever _maxMismatches is set to,
+  a different stored pulse train within one mismatch of the capture would otherwise be hidden by the recent key,
+  the full search decides between them.
+  @param detectedPulseTrain the pulsetrain we want to find a match for
+  @indexes the indexes of the stored pulse trains to match against (as returned in MatchResult.index)
+  @indexCount the number of indexes
+  @result out parameter, the key that was matched along with the match confidence and the runner-up margin
+  @return true if one of the requested pulse trains was the best match and matched exactly
+*/
+bool PulseTrainManager::findPulseTrainIn(vector<int16_t> *detectedPulseTrain, const int *indexes, byte indexCount,
+                                         MatchResult *result)
+{
+    beginMatch(detectedPulseTrain);
+    _matchIndex = _librarySize + _pwmLibrarySize; // not time sliced
     int detectedPulseTrainSize = (*detectedPulseTrain).size();
-    vector<int16_t> pulseTrain; //allocated on the stack
-    int size = getSizeOfLargestPulseTrain();
-    //sout << F("largest pulseTrain: ") << size << endl;           
-    pulseTrain.reserve(size); // the actual storage used is allocated on the heap
-    //sout << F("Address of pulseTrain: ") << (int)&pulseTrain << F(" (0x") << _HEX((int)&pulseTrain) << F(")") << endl;           
-    // Testing using malloc and free
-    //PulseTrainStruct *item = (PulseTrainStruct*)malloc(sizeof(PulseTrainStruct));
-    PulseTrainStruct item;
-    bool itemFound = false;
-    //PRINT_MEM
-    //sout << endl;
-    for (int i = 0; i < pulseTrainArraySize; i++)
-    {
-        memcpy_P(&item, &pulseTrainArray[i], sizeof item);
-        //sout << F("key: ") << item.key << endl;
-        //sout << F("item.pulseTrainSize: ")<< item.pulseTrainSize << endl;
-        //PRINT_MEM
-        // The detected pulse trains always end with the radio silence pulse, so should always be bigger
-        if (detectedPulseTrainSize > item.pulseTrainSize) {
-            // read the pulse train into RAM
-            readProgMem(item.pulseTrain, item.pulseTrainSize, &pulseTrain);
-            //sout << F("pulseTrainSize: ")<< pulseTrain.size() << endl;
-            //PRINT_MEM
-
-            // start from the last item in the pulse train ending at the item at index 1 (ignoring index 0)
-            // the item at index 0 is the sync gap so no need to check it
-            // detectedPulseTrain starts at the last item - 1 (last item is always the radio silence pulse)
-            // count upwards but invert the counter so we can easily start at the end of both PulseTrains
-            int matchCounter = 0;
-            int skipCounter = 0;
-            for (int k = 1; k < item.pulseTrainSize;)
-            {
-                int pulse = pulseTrain[item.pulseTrainSize - k];
-                int index = detectedPulseTrainSize - 1 - k - skipCounter;
-                if (index > -1) {
-                    int detectedPulse = (*detectedPulseTrain)[index];
-                    //sout << F("pulse: ") << pulse << F(" detectedPulse: ") << detectedPulse << endl;
-                    int tolerance = abs((detectedPulse * 10L) / 100);
-                    //sout << F("tolerance: ") << tolerance << endl;
-                    if (pulse < detectedPulse + tolerance && pulse > detectedPulse - tolerance) {
-                        matchCounter++;
-                        k++;
-                    } else {
-                        // If no match start searching pulseTrain again from the new position in detectedPulseTrain
-                        skipCounter++;
-                        matchCounter = 0;
-                        k = 1;
-                    }
-                    // If the pulse train match has not started in the last (pulseTrainSize + 2) pulses, give up
-                    if (skipCounter > item.pulseTrainSize + 2) {
-                        break;
-                    } 
-                    //sout << F("matchCounter: ") << matchCounter << F("skipCounter: ") << skipCounter << endl;
-                } else {
-                    break; //detectedPulseTrain exhausted so exit
-                }          
+    if (detectedPulseTrainSize == 0) return false;
+    const int16_t *detected = &(*detectedPulseTrain)[0];
+    bool pwm = false;
+    for (byte i = 0; i < indexCount; i++)
+    {
+        if (indexes[i] < 0) continue;
+        if (indexes[i] >= _librarySize) {
+            pwm = true;
+            continue;
+        }
+        byte confidence = scoreLibraryItem(detected, detectedPulseTrainSize, indexes[i]);
+        if (confidence > 0) recordCandidate(indexes[i], confidence);
+    }
+    if (pwm) matchPwmPulseTrains(detected, detectedPulseTrainSize);
+    if (_bestIndex < 0 || _bestConfidence < 100) return false;
+    for (byte i = 0; i < indexCount; i++)
+    {
+        if (indexes[i] == _bestIndex) return getMatchResult(result);
+    }
+    return false;
+}
+
+/*
+  Finds the best matching pulsetrain using the prefix trie layout of the pulseTrainArray (ProgMemTrie.cpp)
+  Instead of scoring each stored pulse train separately, the detected pulse train is compared against
+  the trie starting after each sync gap, so the pulses shared by several stored pulse trains are only
+  compared once. A branch is abandoned as soon as it has more than _maxMismatches mismatches.
+  The trie pulses are quantized (within about 5% of the stored pulses) so the confidence can differ slightly
+  from findPulseTrain, the result is reported in the same way and recorded in the same stats.
+  Falls back to findPulseTrain if the trie was not generated from this library (refer to isTrieValid),
+  run tools/build_pulse_trie.py after changing ProgMemGlobals.cpp
+  Also falls back to findPulseTrain when drift tolerant matching is enabled, the trie pulses are shared
+  by several stored pulse trains so they can't be rescaled to each one's time unit.
+  @param detectedPulseTrain the pulsetrain we want to find a match for
+  @result out parameter, the key that was matched along with the match confidence and the runner-up margin
+  @return true if match was found
+*/
+bool PulseTrainManager::findPulseTrainTrie(vector<int16_t> *detectedPulseTrain, MatchResult *result)
+{
+    if (_driftTolerant || !isTrieValid()) {
+        return findPulseTrain(detectedPulseTrain, result);
+    }
+    unsigned long t1 = micros();
+    beginMatch(detectedPulseTrain);
+    _matchIndex = _librarySize + _pwmLibrarySize; // the trie search is not time sliced
+    _trieDetectedSize = (*detectedPulseTrain).size();
+    _trieDetected = _trieDetectedSize > 0 ? &(*detectedPulseTrain)[0] : NULL;
+    _trieMaxMismatches = _maxMismatches;
+    // the last pulse is the radio silence, every other pulse at least as long as the shortest
+    // sync gap (the receiver's start pulse duration) could be the sync gap of a stored pulse train
+    for (int position = _trieDetectedSize - 2; position >= 0; position--)
+    {
+        int16_t pulse = _trieDetected[position];
+        if (pulse < SYNC_GAP_MIN_DURATION && pulse > -SYNC_GAP_MIN_DURATION) continue;
+        searchTrie(position + 1);
+    }
+    if (_trieDetected) matchPwmPulseTrains(_trieDetected, _trieDetectedSize);
+    recordMatchTime(micros() - t1);
+    if (_bestIndex > -1 && keyMatchCounts) keyMatchCounts[_bestIndex]++;
+    return getMatchResult(result);
+}
+
+/*
+  Checks that the prefix trie layout (ProgMemTrie.cpp) was generated from the library being matched against,
+  the checksum of the stored pulse trains is compared with the one saved by tools/build_pulse_trie.py so a
+  trie left over from before a pulse train was changed is not used. Only checked once, it takes about 1ms.
+  @return true if the trie can be used by findPulseTrainTrie
+*/
+bool PulseTrainManager::isTrieValid()
+{
+    if (!_trieChecked) {
+        _trieValid = _library == pulseTrainArray && pulseTrieEntryCount == _librarySize &&
+                     pulseTrieChecksum == getLibraryChecksum();
+        _trieChecked = true;
+    }
+    return _trieValid;
+}
+
+/*
+  Enables or disables drift tolerant matching
+  Cheap remotes with RC oscillators drift with temperature and battery voltage by more than the 10% matching tolerance.
+  When enabled, the time unit of the detected pulse train (the average length of its short pulses) is estimated
+  at the start of each search and each stored pulse train is rescaled to it before being compared, using a tighter
+  tolerance (about 8.6%). Stored pulse trains with a time unit more than about 30% away are not compared at all.
+  The time unit of each stored pulse train is estimated once when first enabled, 2 bytes of RAM per stored pulse train.
+  Must not be called while a search is in progress.
+  @enabled true to enable drift tolerant matching
+  @return true if drift tolerant matching is enabled, false if it is disabled or there was not enough RAM
+*/
+bool PulseTrainManager::setDriftTolerant(bool enabled)
+{
+    if (enabled && !_units && _librarySize > 0) {
+        // allocated once and kept for the lifetime of the program
+        _units = (int16_t*)malloc(_librarySize * sizeof(int16_t));
+        PulseTrainStruct item;
+        for (int i = 0; _units && i < _librarySize; i++)
+        {
+            memcpy_P(&item, &_library[i], sizeof item);
+            _units[i] = estimateUnit(item.pulseTrain, item.pulseTrainSize, true);
+        }
+    }
+    _driftTolerant = enabled && _units;
+    return _driftTolerant;
+}
+
+/*
+  Private: Estimates the time unit of a pulse train, the average length of its short pulses
+  The short pulses are those shorter than the average pulse but longer than a quarter of it, so that the long
+  pulses, sync gaps and any glitches are left out. Integer only so it is quick on an 8 bit mcu.
+  @pulses pointer to the first pulse
+  @size the number of pulses
+  @inProgmem true if the pulses are stored in progmem
+  @return the time unit in microseconds, 0 if there are not enough short pulses to estimate it
+*/
+int16_t PulseTrainManager::estimateUnit(const int16_t *pulses, int size, bool inProgmem)
+{
+    long total = 0;
+    int count = 0;
+    for (int i = 0; i < size; i++)
+    {
+        int16_t pulse = abs(inProgmem ? (int16_t)pgm_read_word_near(pulses + i) : pulses[i]);
+        // sync gaps are at least as long as the receiver's start pulse duration
+        if (pulse >= SYNC_GAP_MIN_DURATION) continue;
+        total += pulse;
+        count++;
+    }
+    if (count == 0) return 0;
+    int16_t average = total / count;
+    total = 0;
+    count = 0;
+    for (int i = 0; i < size; i++)
+    {
+        int16_t pulse = abs(inProgmem ? (int16_t)pgm_read_word_near(pulses + i) : pulses[i]);
+        if (pulse <= (average >> 2) || pulse >= average) continue;
+        total += pulse;
+        count++;
+    }
+    if (count < 4) return 0;
+    return total / count;
+}
+
+/*
+  Private: Compares the trie against the detected pulse train starting at a position, depth first
+  Iterative rather than recursive so the stack used is fixed, the nodes whose children are still to be compared
+  are kept in an array of PULSE_TRIE_MAX_DEPTH frames (tools/build_pulse_trie.py makes sure the trie fits).
+  A node's run of pulses is compared and its children are only visited if it has no more than _trieMaxMismatches.
+  @position index of the detected pulse to compare with the first pulse after the sync gap
+*/
+void PulseTrainManager::searchTrie(int position)
+{
+    /*
+      A node whose children are still to be compared
+      nextChild: index of the next child to compare in pulseTrieNodes
+      childrenLeft: number of children still to be compared
+      position, comparedCount, mismatches: the state after comparing the node, the starting state of each child
+    */
+    struct TrieFrame {
+        uint16_t nextChild;
+        uint8_t childrenLeft;
+        uint8_t mismatches;
+        int16_t position;
+        int16_t comparedCount;
+    };
+    TrieFrame frames[PULSE_TRIE_MAX_DEPTH];
+    byte depth = 0;
+    PulseTrieNode node;
+    int nodeIndex = 0;
+    int comparedCount = 0;
+    int mismatches = 0;
+    while (true)
+    {
+        memcpy_P(&node, &pulseTrieNodes[nodeIndex], sizeof node);
+        bool matched = true;
+        for (byte k = 0; k < node.pulseCount; k++, position++)
+        {
+            int16_t pulse = pgm_read_word_near(&pulseTriePulses[node.pulseStart + k]);
+            int16_t tolerance = pulseTolerance(pulse);
+            // pulses beyond the end of the detected pulse train (or the radio silence pulse) count as mismatches
+            if (position >= _trieDetectedSize - 1 ||
+                _trieDetected[position] <= pulse - tolerance || _trieDetected[position] >= pulse + tolerance) {
+                if (++mismatches > _trieMaxMismatches) {
+                    matched = false;
+                    break;
+                }
             }
-            pulseTrain.clear(); //must make sure it is cleared for the next iteration
-            //sout << F("pulseTrain cleared") << endl;
-            //PRINT_MEM
-            if (matchCounter > item.pulseTrainSize - 2) {
-                itemFound = true;
-                //sout << F("Match Found!") << endl;
-                break;
+        }
+        if (matched) {
+            comparedCount += node.pulseCount;
+            if (node.entry >= 0 && comparedCount > 0 && mismatches < comparedCount) {
+                recordCandidate(node.entry, ((comparedCount - mismatches) * 100) / comparedCount);
+            }
+            if (node.childCount > 0 && depth < PULSE_TRIE_MAX_DEPTH) {
+                TrieFrame &frame = frames[depth++];
+                frame.nextChild = node.firstChild;
+                frame.childrenLeft = node.childCount;
+                frame.mismatches = mismatches;
+                frame.position = position;
+                frame.comparedCount = comparedCount;
             }
         }
-        //sout << endl;
+        // carry on with the next child of the deepest node which has children left
+        while (depth > 0 && frames[depth - 1].childrenLeft == 0) depth--;
+        if (depth == 0) return;
+        TrieFrame &frame = frames[depth - 1];
+        nodeIndex = frame.nextChild++;
+        frame.childrenLeft--;
+        position = frame.position;
+        comparedCount = frame.comparedCount;
+        mismatches = frame.mismatches;
     }
-    unsigned long time = micros() - t1;
-    // This function takes ...... to search through a pulseTrainArraySize of 19 elements
-    //sout << F("time: ") << time << endl;
-    if (itemFound) {
-        strcpy(key,item.key);
-        return true;
+}
+
+/*
+  Private: Updates the best match and the runner-up with the score of a stored pulse train
+  @index the index of the stored pulse train in the library
+  @confidence the score of the stored pulse train
+*/
+void PulseTrainManager::recordCandidate(int index, byte confidence)
+{
+    char key[6];
+    readKey(index, key);
+    if (confidence > _bestConfidence) {
+        // the previous best only becomes the runner-up if it has a different key
+        if (_bestIndex > -1 && strcmp(_matchResult.key, key) != 0) {
+            _runnerUpConfidence = _bestConfidence;
+        }
+        _bestIndex = index;
+        _bestConfidence = confidence;
+        strcpy(_matchResult.key, key);
+    } else if (confidence > _runnerUpConfidence && strcmp(_matchResult.key, key) != 0) {
+        _runnerUpConfidence = confidence;
+    }
+}
+
+/*
+  Private: Reads the key of an element of the library or the PWM library
+  @index the index of the element, the PWM library follows the library
+  @key out parameter, the key of the element
+*/
+void PulseTrainManager::readKey(int index, char (&key)[6])
+{
+    if (index < _librarySize) {
+        memcpy_P(key, _library[index].key, sizeof key);
     } else {
-        return false;
+        memcpy_P(key, _pwmLibrary[index - _librarySize].key, sizeof key);
     }
 }
 
+/*
+  Private: Matches the detected pulse train against the bit-packed PWM library
+  Each repeat in the detected pulse train (the pulses between a sync gap and the next one or the radio silence)
+  is decoded into bits once: a pair of pulses is a 1 if the high pulse is at least 1.5 times longer than the low pulse,
+  a 0 if the low pulse is at least 1.5 times longer than the high pulse, otherwise it is marked as an error.
+  The decoded bits are then compared with each stored pulse train that has the same number of bits and
+  similar symbol timings using XOR and a bit count, an error counts as a mismatched bit.
+  @detected pointer to the first pulse of the detected pulse train
+  @detectedSize the number of pulses in the detected pulse train
+*/
+void PulseTrainManager::matchPwmPulseTrains(const int16_t *detected, int detectedSize)
+{
+    if (_pwmLibrarySize == 0) return;
+    byte bits[PWM_BITS_SIZE];
+    byte errors[PWM_BITS_SIZE];
+    PwmPulseTrainStruct item;
+    int end = detectedSize - 1; // the radio silence pulse follows the last repeat
+    for (int position = detectedSize - 2; position >= 0; position--)
+    {
+        int16_t pulse = detected[position];
+        if (pulse < SYNC_GAP_MIN_DURATION && pulse > -SYNC_GAP_MIN_DURATION) continue;
+        // the repeat is the sync gap at position followed by the symbols and a short high pulse before end
+        int pulseCount = end - position - 1;
+        end = position;
+        if (pulseCount < 3 || pulseCount > PWM_MAX_BITS * 2 + 1 || (pulseCount & 1) == 0) continue;
+        byte bitCount = pulseCount / 2;
+        memset(bits, 0, sizeof bits);
+        memset(errors, 0, sizeof errors);
+        long shortTotal = 0;
+        long longTotal = 0;
+        byte validCount = 0;
+        const int16_t *symbol = detected + position + 1;
+        for (byte b = 0; b < bitCount; b++, symbol += 2)
+        {
+            int16_t high = symbol[0];
+            int16_t low = -symbol[1];
+            byte mask = 0x80 >> (b & 7);
+            if (high > 0 && low > 0 && high >= low + (low >> 1)) {
+                bits[b >> 3] |= mask;
+                shortTotal += low;
+                longTotal += high;
+                validCount++;
+            } else if (high > 0 && low > 0 && low >= high + (high >> 1)) {
+                shortTotal += high;
+                longTotal += low;
+                validCount++;
+            } else {
+                errors[b >> 3] |= mask;
+            }
+        }
+        if (validCount == 0) continue;
+        int16_t shortPulse = shortTotal / validCount;
+        int16_t longPulse = longTotal / validCount;
+        int allowedMismatches = _maxMismatches;
+        byte usedBytes = (bitCount + 7) / 8;
+        byte lastMask = 0xFF << ((usedBytes * 8) - bitCount);
+        for (int i = 0; i < _pwmLibrarySize; i++)
+        {
+            // most of the stored pulse trains are rejected on their bit count without reading the rest
+            if (pgm_read_byte_near(&_pwmLibrary[i].bitCount) != bitCount) continue;
+            memcpy_P(&item, &_pwmLibrary[i], sizeof item);
+            if (_driftTolerant) {
+                // the short pulse gives the drift, the long pulse must then be in the same proportion to it
+                int16_t ratio = ((long)shortPulse << 8) / item.shortPulse;
+                if (ratio < DRIFT_MIN_RATIO || ratio > DRIFT_MAX_RATIO) continue;
+                int16_t expectedLong = ((long)item.longPulse * ratio) >> 8;
+                if (abs(longPulse - expectedLong) >= scaledPulseTolerance(expectedLong)) continue;
+            } else if (abs(shortPulse - item.shortPulse) >= pulseTolerance(item.shortPulse) ||
+                abs(longPulse - item.longPulse) >= pulseTolerance(item.longPulse)) {
+                continue;
+            }
+            int mismatches = 0;
+            for (byte k = 0; k < usedBytes && mismatches <= allowedMismatches; k++)
+            {
+                byte difference = (bits[k] ^ pgm_read_byte_near(item.bits + k)) | errors[k];
+                if (k == usedBytes - 1) difference &= lastMask;
+                mismatches += __builtin_popcount(difference);
+            }
+            if (mismatches > allowedMismatches) continue;
+            recordCandidate(_librarySize + i, ((bitCount - mismatches) * 100) / bitCount);
+        }
+    }
+}
+
+/*
+  Private: Adds a search time to the match time histogram
+  @time the time taken to search through the stored pulse trains in microseconds
+*/
+void PulseTrainManager::recordMatchTime(unsigned long time)
+{
+    byte bucket = 0;
+    while (bucket < MATCH_TIME_BUCKETS - 1 && time >= pgm_read_word_near(&matchTimeLimits[bucket])) {
+        bucket++;
+    }
+    matchTimeHistogram[bucket]++;
+}
+
+/*
+  Prints the match time histogram and the match count of each key in a compact form
+  @port the serial port to use
+*/
+void PulseTrainManager::printStats(HardwareSerial &port)
+{
+    port.print(F("match us"));
+    for (byte i = 0; i < MATCH_TIME_BUCKETS; i++) {
+        if (i < MATCH_TIME_BUCKETS - 1) {
+            port.print(F(" <")); port.print(pgm_read_word_near(&matchTimeLimits[i]));
+        } else {
+            port.print(F(" >="));  port.print(pgm_read_word_near(&matchTimeLimits[i - 1]));
+        }
+        port.print(F(":")); port.print(matchTimeHistogram[i]);
+    }
+    port.println();
+    port.print(F("keys"));
+    char key[6];
+    for (int i = 0; keyMatchCounts && i < _librarySize + _pwmLibrarySize; i++) {
+        if (keyMatchCounts[i] == 0) continue;
+        readKey(i, key);
+        port.print(F(" ")); port.print(key); port.print(F(":")); port.print(keyMatchCounts[i]);
+    }
+    port.println();
+}
+
+/*
+  Private: Scores an element of the library against the detected pulsetrain, rescaling it to the
+  detected pulse train's time unit first when drift tolerant matching is enabled
+  @detected pointer to the first pulse of the detected pulse train
+  @detectedSize the number of pulses in the detected pulse train
+  @index the index of the element in the library
+  @return percentage of the stored pulses which matched, 0 if more than _maxMismatches did not match
+*/
+byte PulseTrainManager::scoreLibraryItem(const int16_t *detected, int detectedSize, int index)
+{
+    PulseTrainStruct item;
+    memcpy_P(&item, &_library[index], sizeof item);
+    if (_detectedUnit > 0 && _units[index] > 0) {
+        // 8.8 fixed point ratio of the detected time unit to the stored one
+        int16_t ratio = ((long)_detectedUnit << 8) / _units[index];
+        if (ratio < DRIFT_MIN_RATIO || ratio > DRIFT_MAX_RATIO) return 0;
+        return scorePulseTrain(detected, detectedSize, item, ratio);
+    }
+    return scorePulseTrain(detected, detectedSize, item, 0);
+}
+
+/*
+  Private: Scores a stored pulsetrain against the detected pulsetrain
+  The detected pulse trains always end with the radio silence pulse and usually contain several repeats,
+  so the stored pulse train is aligned with the end of the detected pulse train (ignoring the radio silence pulse)
+  and slid towards the start of it one pulse at a time, the best alignment is used as the score.
+  The item at index 0 of the stored pulse train is the sync gap so there is no need to check it.
+  An alignment is abandoned as soon as it has more mismatches than the best alignment found so far
+  or more than _maxMismatches, so most alignments only cost a few comparisons.
+  @detected pointer to the first pulse of the detected pulse train
+  @detectedSize the number of pulses in the detected pulse train
+  @item the stored pulse train to score (the pulse array is in progmem)
+  @ratio 8.8 fixed point ratio used to rescale the stored pulses to the detected pulse train's time unit
+  (drift tolerant matching, compared using the tighter tolerance), 0 to compare them as they are
+  @return percentage of the stored pulses which matched, 0 if more than _maxMismatches did not match
+*/
+byte PulseTrainManager::scorePulseTrain(const int16_t *detected, int detectedSize, const PulseTrainStruct &item,
+                                        int16_t ratio)
+{
+    int comparedCount = item.pulseTrainSize - 1;
+    if (comparedCount < 1 || detectedSize <= item.pulseTrainSize) return 0;
+    // mismatches allowed before an alignment is abandoned
+    int allowedMismatches = _maxMismatches;
+    int bestMismatches = allowedMismatches + 1;
+    // If the pulse train match has not started in the last (pulseTrainSize + 2) pulses, give up
+    for (int skip = 0; skip <= item.pulseTrainSize + 2 && bestMismatches > 0; skip++)
+    {
+        int mismatches = 0;
+        for (int k = 1; k < item.pulseTrainSize; k++)
+        {
+            int index = detectedSize - 1 - k - skip;
+            if (index < 0) {
+                // detectedPulseTrain exhausted, the remaining stored pulses count as mismatches
+                mismatches += item.pulseTrainSize - k;
+                break;
+            }
+            int16_t pulse = pgm_read_word_near(item.pulseTrain + item.pulseTrainSize - k);
+            int16_t tolerance;
+            if (ratio) {
+                pulse = ((long)pulse * ratio) >> 8;
+                tolerance = scaledPulseTolerance(pulse);
+            } else {
+                tolerance = pulseTolerance(pulse);
+            }
+            int16_t detectedPulse = detected[index];
+            if (detectedPulse <= pulse - tolerance || detectedPulse >= pulse + tolerance) {
+                if (++mismatches >= bestMismatches) break;
+            }
+        }
+        if (mismatches < bestMismatches) bestMismatches = mismatches;
+    }
+    if (bestMismatches > allowedMismatches) return 0;
+    return ((comparedCount - bestMismatches) * 100) / comparedCount;
+}
+
 /*
   Private: Finds the largest pulsetrain in the pulseTrainArray
   @return the size as an int
@@ -119,32 +635,67 @@ int PulseTrainManager::getSizeOfLargestPulseTrain()
 {
     PulseTrainStruct item;
     int size = 0;
-    for (int i = 0; i < pulseTrainArraySize; i++)
+    for (int i = 0; i < _librarySize; i++)
     {
-        memcpy_P(&item, &pulseTrainArray[i], sizeof item);
+        memcpy_P(&item, &_library[i], sizeof item);
         if (item.pulseTrainSize > size) size = item.pulseTrainSize;
     }
     return size;
 }
 
+/*
+  Private: Calculates a checksum of the sizes and pulses of the pulse trains in the library
+  Order sensitive so that any changed, added, removed or reordered pulse changes it,
+  must match library_checksum in tools/build_pulse_trie.py
+  @return the checksum
+*/
+uint16_t PulseTrainManager::getLibraryChecksum()
+{
+    PulseTrainStruct item;
+    uint16_t checksum = 0;
+    for (int i = 0; i < _librarySize; i++)
+    {
+        memcpy_P(&item, &_library[i], sizeof item);
+        checksum = checksum * 31 + (uint16_t)item.pulseTrainSize;
+        for (int k = 0; k < item.pulseTrainSize; k++)
+        {
+            checksum = checksum * 31 + pgm_read_word_near(item.pulseTrain + k);
+        }
+    }
+    return checksum;
+}
+
 /*
   Gets a pulsetrain from the pulseTrainArray based on its key
   @param key the 5 character char array (5 chars plus null terminator)
+  @param profile optional out parameter, set to the transmit profile of the pulsetrain, all 0 (the defaults) if it is not found
   @return an instance of vector<int16_t> containing the pulsetrain
 */
-vector<int16_t> PulseTrainManager::get(char (&key)[6])
+vector<int16_t> PulseTrainManager::get(char (&key)[6], TransmitProfile *profile)
 {
     // This function takes 192us to search through pulseTrainArraySize of 19 elements
     //unsigned long t1 = micros();
     vector<int16_t> pulseTrain;
+    if (profile) memset(profile, 0, sizeof *profile);
     PulseTrainStruct item;
-    for (int i = 0; i < pulseTrainArraySize; i++)
+    for (int i = 0; i < _librarySize; i++)
     {
-        memcpy_P(&item, &pulseTrainArray[i], sizeof item);
+        memcpy_P(&item, &_library[i], sizeof item);
         //Serial.println(item.key);
         if (strcmp(key, item.key) == 0) {
+            if (profile) *profile = item.profile;
             pulseTrain.reserve(item.pulseTrainSize);
             readProgMem(item.pulseTrain, item.pulseTrainSize, &pulseTrain);
+            return pulseTrain;
+        }
+    }
+    char pwmKey[6];
+    for (int i = 0; i < _pwmLibrarySize; i++)
+    {
+        memcpy_P(pwmKey, _pwmLibrary[i].key, sizeof pwmKey);
+        if (strcmp(key, pwmKey) == 0) {
+            if (profile) memcpy_P(profile, &_pwmLibrary[i].profile, sizeof *profile);
+            readPwmProgMem(&_pwmLibrary[i], &pulseTrain);
             break;
         }
     }
@@ -153,6 +704,35 @@ vector<int16_t> PulseTrainManager::get(char (&key)[6])
     return pulseTrain; // the compiler implements passing by reference for objects
 }
 
+/*
+  Gets the transmit profile of a pulsetrain without reading its pulses
+  @param key the 5 character char array (5 chars plus null terminator)
+  @param profile out parameter, set to the transmit profile of the pulsetrain, all 0 (the defaults) if it is not found
+  @return true if the key was found
+*/
+bool PulseTrainManager::getProfile(char (&key)[6], TransmitProfile *profile)
+{
+    memset(profile, 0, sizeof *profile);
+    char itemKey[6];
+    for (int i = 0; i < _librarySize; i++)
+    {
+        memcpy_P(itemKey, _library[i].key, sizeof itemKey);
+        if (strcmp(key, itemKey) == 0) {
+            memcpy_P(profile, &_library[i].profile, sizeof *profile);
+            return true;
+        }
+    }
+    for (int i = 0; i < _pwmLibrarySize; i++)
+    {
+        memcpy_P(itemKey, _pwmLibrary[i].key, sizeof itemKey);
+        if (strcmp(key, itemKey) == 0) {
+            memcpy_P(profile, &_pwmLibrary[i].profile, sizeof *profile);
+            return true;
+        }
+    }
+    return false;
+}
+
 /*
   Private: Reads a pulsetrain from the the program memory (flash)
   @param location a pointer to an int16_t array stored in progmem
@@ -169,8 +749,32 @@ void PulseTrainManager::readProgMem(int16_t *location, int size, vector<int16_t>
     }
 }
 
+/*
+  Private: Rebuilds a pulsetrain from a bit-packed PWM pulse train stored in program memory (flash)
+  @param location a pointer to a PwmPulseTrainStruct stored in progmem
+  @pulsetrain out paramter, the vector<int16_t> to be filled with the sync gap, symbols and the final short high pulse
+*/
+void PulseTrainManager::readPwmProgMem(const PwmPulseTrainStruct *location, vector<int16_t> *pulseTrain) {
+    PwmPulseTrainStruct item;
+    memcpy_P(&item, location, sizeof item);
+    pulseTrain->reserve(item.bitCount * 2 + 2);
+    pulseTrain->push_back(item.syncGap);
+    for (byte b = 0; b < item.bitCount; b++)
+    {
+        if (pgm_read_byte_near(item.bits + (b >> 3)) & (0x80 >> (b & 7))) {
+            pulseTrain->push_back(item.longPulse);
+            pulseTrain->push_back(-item.shortPulse);
+        } else {
+            pulseTrain->push_back(item.shortPulse);
+            pulseTrain->push_back(-item.longPulse);
+        }
+    }
+    pulseTrain->push_back(item.shortPulse);
+}
+
 // Destructor
 PulseTrainManager::~PulseTrainManager()
 {
-    // nothing to destruct here
+    free(keyMatchCounts);
+    free(_units);
 }
\ No newline at end of file
@@ -13,21 +13,93 @@
 #include <AvrSTL.h>
 #include <vector>
 #include <avr/pgmspace.h>
+#include "ProgMemGlobals.h"
 using std::vector;
 
+// Number of buckets in the match time histogram, refer to the cpp file for the bucket limits
+#define MATCH_TIME_BUCKETS 7
+// Limits of the time unit ratio between a detected and a stored pulse train when drift tolerant matching is enabled
+// in 8.8 fixed point (256 = 1.0), a ratio outside of these limits is not treated as the same remote
+#define DRIFT_MIN_RATIO 179 // 0.70
+#define DRIFT_MAX_RATIO 366 // 1.43
+
+/*
+  The result of matching a detected pulse train against the stored pulse trains
+  key: the key of the best matching pulse train
+  confidence: percentage of the stored pulses that matched the detected pulse train (0 - 100)
+  margin: confidence difference between the best match and the runner-up with a different key
+  index: index of the matched pulse train in the library, the PWM library follows the library
+*/
+struct MatchResult {
+  char key[6];
+  int index;
+  byte confidence;
+  byte margin;
+};
+typedef struct MatchResult MatchResult;
+
 class PulseTrainManager
 {
   public:
     // Default Constructor
     PulseTrainManager();
+    PulseTrainManager(const PulseTrainStruct *library, int librarySize,
+                      const PwmPulseTrainStruct *pwmLibrary = NULL, int pwmLibrarySize = 0);
     bool findPulseTrain(vector<int16_t> *detectedPulseTrain, char (&key)[6]);
-    vector<int16_t> get(char (&key)[6]); // name is passed by reference, 5 chars + nul terminator
+    bool findPulseTrain(vector<int16_t> *detectedPulseTrain, MatchResult *result);
+    void beginMatch(vector<int16_t> *detectedPulseTrain);
+    bool continueMatch(unsigned long maxTime);
+    bool isMatchComplete();
+    bool getMatchResult(MatchResult *result);
+    bool findPulseTrainIn(vector<int16_t> *detectedPulseTrain, const int *indexes, byte indexCount, MatchResult *result);
+    bool findPulseTrainTrie(vector<int16_t> *detectedPulseTrain, MatchResult *result);
+    bool isTrieValid();
+    bool setDriftTolerant(bool enabled);
+    vector<int16_t> get(char (&key)[6], TransmitProfile *profile = NULL); // name is passed by reference, 5 chars + nul terminator
+    bool getProfile(char (&key)[6], TransmitProfile *profile);
+    void printStats(HardwareSerial &port);
+
+    // Performance counters, kept since boot
+    unsigned int matchTimeHistogram[MATCH_TIME_BUCKETS]; // number of searches completed within each time bucket
+    unsigned int *keyMatchCounts; // number of matches for each element of the library followed by the PWM library
     // Destructor
     ~PulseTrainManager();
 
   private:
+    const PulseTrainStruct *_library; // array of PulseTrainStruct in progmem, defaults to pulseTrainArray
+    const int _librarySize;
+    const PwmPulseTrainStruct *_pwmLibrary; // array of PwmPulseTrainStruct in progmem, defaults to pwmPulseTrainArray
+    const int _pwmLibrarySize;
+    const byte _maxMismatches; // maximum number of compared pulses (or PWM bits) which may not match for a pulse train to be accepted
+    bool _driftTolerant; // rescale the detected pulse train to each stored pulse train's time unit before comparing
+    int16_t *_units; // time unit of each element of the library, only allocated when drift tolerant matching is enabled
+    int16_t _detectedUnit; // time unit of the detected pulse train, 0 if it could not be estimated
+    // State of the search started by beginMatch
+    vector<int16_t> *_matchDetected;
+    int _matchIndex; // next element of the library to be scored, the PWM library follows the library
+    int _bestIndex;
+    byte _bestConfidence;
+    byte _runnerUpConfidence;
+    unsigned long _matchTime; // microseconds spent searching
+    MatchResult _matchResult;
+    // State of the trie search carried out by findPulseTrainTrie
+    bool _trieChecked; // the trie has been checked against the library by isTrieValid
+    bool _trieValid; // the trie was generated from the library
+    const int16_t *_trieDetected;
+    int _trieDetectedSize;
+    int _trieMaxMismatches;
+    void readKey(int index, char (&key)[6]);
+    void recordCandidate(int index, byte confidence);
+    void matchPwmPulseTrains(const int16_t *detected, int detectedSize);
+    void searchTrie(int position);
+    void recordMatchTime(unsigned long time);
+    byte scoreLibraryItem(const int16_t *detected, int detectedSize, int index);
+    byte scorePulseTrain(const int16_t *detected, int detectedSize, const PulseTrainStruct &item, int16_t ratio);
+    int16_t estimateUnit(const int16_t *pulses, int size, bool inProgmem);
     int getSizeOfLargestPulseTrain();
+    uint16_t getLibraryChecksum();
     void readProgMem(int16_t *location, int size, vector<int16_t> *pulseTrain);
+    void readPwmProgMem(const PwmPulseTrainStruct *location, vector<int16_t> *pulseTrain);
 };
 
 #endif
\ No newline at end of file
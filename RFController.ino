@@ -17,9 +17,15 @@
 #include "ProgMemGlobals.h"
 #include "Receiver.h"
 #include "Timer2.h"
+#include "Scheduler.h"
+#include "OutputQueue.h"
+#include "CaptureHistory.h"
+#include "TransmitQueue.h"
+#include "MemoryMonitor.h"
 #include "MemoryInfo.h"
 #include "Vcc.h"
 #include "Streaming.h"
+#include <avr/sleep.h>
 using std::vector;
 using namespace SerialHelper;
 using namespace MemoryInfo;
@@ -28,20 +34,25 @@ using namespace MemoryInfo;
 //#define DEBUG 1
 // Uncomment this to enable memory debug mode
 //#define MEM_DEBUG 1
+// Uncomment this to match using the prefix trie layout of the stored pulse trains (ProgMemTrie.cpp)
+//#define PULSE_TRIE 1
+// Uncomment this to rescale each captured pulse train to the stored pulse trains' time unit before matching
+// (for remotes whose timing drifts with temperature and battery voltage)
+//#define DRIFT_TOLERANT 1
 
 HardwareSerial &sout = Serial; //create an alias for the Serial class
 
 // The number of times to transmit the pulse train (to overcome errors and interference)
-static const byte repeatCount = 6; // repeat count of between 4 and 6 seems to be what most devices use
+static const byte repeatCount = 6; // repeat count of between 4 and 6 seems to be what most devices use, a library entry can override it with its transmit profile
 static const int ledPin = LED_BUILTIN; // use the built in LED on the aruduino board
 // The pins connected to the Receiver module's data pin
 static const int receiverPinA = 2;  // pin2 is INT0 on an Arduino Uno / 328p
 static const int receiverPinB = 3;  // pin3 is INT1 on an Arduino Uno / 328p
 // The pin connected to the transmitter module's data pin
 static const int outputPin = 4;
-// These value control the flashing of the LED (defines an 'on' duration within a range 0 to 65536)
-static const unsigned int ledOn = 1;
-static const unsigned int ledOff = 10000;
+// These values control the flashing of the LED while scanning (milliseconds)
+static const unsigned int ledOnDuration = 100;
+static const unsigned int ledPeriod = 1000;
 Timer2 timer2;
 Receiver receiver(&timer2, receiverPinA, receiverPinB, ledPin);
 static const int initialPulse = 6674;
@@ -52,11 +63,45 @@ static char cmdBuffer[CMDBUFFER_SIZE];
 vector<int16_t> *detectedPulseTrain;
 const float VccCorrection = 5.0/5.0;  // Measured Vcc by multimeter divided by reported Vcc
 Vcc vcc(VccCorrection);
-/* Define a structure with bit fields */
-static struct {
-   unsigned int serialDataReceived : 1;
-   unsigned int pulseTrainReceived : 1;
-} event;
+// Scheduler and task ids, refer to setupTasks() for the task priorities
+static Scheduler scheduler;
+static byte outputTask, transmitTask, serialTask, matchTask, repeatTask, debugTask, receiveTask;
+// Buffered serial output, the debug lane needs to hold the longest line printed by Receiver::printDebug
+static const byte outputEventSize = 32;
+static const byte outputDebugSize = 96;
+static OutputQueue output(Serial, outputEventSize, outputDebugSize);
+static unsigned int debugLine = 0; // next line of the debug output to be printed by printPulseTrain
+static const unsigned long matchTimeSlice = 2000; // maximum microseconds spent matching before other tasks can run
+// The later repeats of a button press are recognised and only reported once, refer to receivePulseTrain()
+static const unsigned int repeatHoldOff = 500; // ms after a capture during which the same key is treated as a repeat
+static CaptureHistory captureHistory(repeatHoldOff);
+static unsigned long captureTime = 0; // millis() when the pulse train being matched was captured
+// Worst case SRAM use since boot, shown by the MEM command
+static MemoryMonitor memoryMonitor;
+#ifdef PULSE_TRIE
+  static unsigned int trieStackSize = 0; // bytes of stack used by the trie search, measured on the first search
+#endif
+// Commands waiting to be transmitted, a burst of commands is coalesced and limited to a share of the airtime
+// so the radio is not tied up and the receiver can listen in between, refer to transmitPulseTrain()
+static const unsigned int airtimeBudget = 6000; // ms of transmission allowed in each airtimeWindow (10% duty cycle)
+static const unsigned long airtimeWindow = 60000; // length of the rolling window in ms
+static TransmitQueue transmitQueue(airtimeBudget, airtimeWindow);
+// Listen before talk, wait for other devices to finish transmitting before sending
+static const unsigned int clearChannelWindow = 50; // the channel is busy for this many ms after a sync gap is received
+static const unsigned int maxChannelWait = 500; // maximum ms to wait for a clear channel before transmitting anyway
+static const unsigned int channelRetryDelay = 5; // ms between checks for a clear channel while waiting
+static unsigned long txWaitStart = 0; // millis() when the transmit task started waiting for a clear channel
+static unsigned long txRetryTime = 0; // millis() when the channel was last found to be busy
+// Transmissions confirmed by receiving our own echo
+static unsigned int echoConfirmedCount = 0;
+static unsigned int echoMissedCount = 0;
+// Transmitter timing calibration, refer to calibrateTransmitter()
+static const int calibrationAddress = 0; // EEPROM address of the transmitter's timing corrections
+static const byte calibrationRounds = 3; // each round refines the corrections from the previous round
+static const byte calibrationRepeatCount = 4;
+// Test pattern with short, medium and long pulses of both polarities in different combinations
+static const int16_t calibrationPattern[] PROGMEM = { -6000,300,-300,600,-600,300,-600,600,-300,1200,-1200,
+                                                      300,-1200,1200,-300,600,-1200,1200,-600,300,-300,600,-600,300 };
 
 
 void setup() {
@@ -67,6 +112,12 @@ void setup() {
   Serial.println();
   // Configures the Receiver and timer ready for scanning
   receiver.configure();
+  setupTasks();
+  // Use the transmitter timing corrections saved by the CALIB command
+  transmitter.loadCorrection(calibrationAddress);
+  #ifdef DRIFT_TOLERANT
+    pulseTrainManager.setDriftTolerant(true);
+  #endif
   // The supply voltage needs to be close to 5v for the 433Mhz recevier to work properly
   float supplyVoltage = vcc.Read_Volts();
   PRINT_COMPILE_INFO
@@ -77,6 +128,11 @@ void setup() {
   #endif
   sout << F("VCC: ") << supplyVoltage << F(" Volts") << endl;
   sout << F("PulseTrain Array Size: ") << pulseTrainArraySize << endl;
+  #ifdef PULSE_TRIE
+    if (!pulseTrainManager.isTrieValid()) sout << F("ProgMemTrie.cpp is out of date, run tools/build_pulse_trie.py") << endl;
+  #endif
+  sout << F("TX correction high: ") << transmitter.getHighCorrection()
+       << F("us low: ") << transmitter.getLowCorrection() << F("us") << endl;
 
   digitalWrite(ledPin, HIGH);
   delay(1000);
@@ -88,77 +144,361 @@ void setup() {
 }
 
 void loop() {
-  // Set the bit fields in the struct depending on which data is available
-  event.pulseTrainReceived = (receiver.available(ledOff, ledOn ) > 0);
-  event.serialDataReceived = (readLine(Serial.read(), cmdBuffer, CMDBUFFER_SIZE) > 0);
+  memoryMonitor.update();
+  // Make the tasks ready depending on which data is available
+  if (receiver.available(ledOnDuration, ledPeriod) > 0) scheduler.setReady(receiveTask);
+  if (Serial.available() > 0) scheduler.setReady(serialTask);
+  if (output.pending() && Serial.availableForWrite() > 0) scheduler.setReady(outputTask);
+  if (captureHistory.hasExpired(millis())) scheduler.setReady(repeatTask);
+  if (transmitQueue.isReady(millis()) && (txWaitStart == 0 || millis() - txRetryTime >= channelRetryDelay)) {
+    scheduler.setReady(transmitTask);
+  }
+  // Pause for debugging
+  //while (true) {}
+  if (!scheduler.run()) waitForEvent();
+}
 
-  if (event.pulseTrainReceived) {
-    digitalWrite(ledPin, HIGH);
-    detectedPulseTrain = new vector<int16_t>; // Allocated on the heap
-    receiver.getPulseTrain(detectedPulseTrain);
+/*
+  Adds the tasks to the scheduler, a higher number is a higher priority
+  Writing the buffered output only takes a few microseconds so it goes first, then transmitting so that a command is never held up by a match in progress,
+  debug printing is deferred until after any matching and receive is the lowest priority so that a
+  new capture is only taken once the previous one has been matched (and printed in debug mode)
+*/
+void setupTasks() {
+  outputTask = scheduler.addTask(writeOutput, 5, F("output"));
+  transmitTask = scheduler.addTask(transmitPulseTrain, 4, F("transmit"));
+  serialTask = scheduler.addTask(readSerial, 3, F("serial"));
+  matchTask = scheduler.addTask(matchPulseTrain, 2, F("match"));
+  repeatTask = scheduler.addTask(reportRepeats, 1, F("repeat"));
+  debugTask = scheduler.addTask(printPulseTrain, 1, F("debug"));
+  receiveTask = scheduler.addTask(receivePulseTrain, 0, F("receive"));
+}
+
+/*
+  Task: reads the serial port and handles a command once a complete line has been received
+  @return true if there is more serial data waiting
+*/
+bool readSerial() {
+  if (readLine(Serial.read(), cmdBuffer, CMDBUFFER_SIZE) > 0) {
+    if (strcmp(cmdBuffer, "STATS") == 0) {
+      printPerformanceStats();
+    } else if (strcmp(cmdBuffer, "MEM") == 0) {
+      printMemoryStats();
+    } else if (strcmp(cmdBuffer, "CALIB") == 0) {
+      calibrateTransmitter();
+    } else {
+      output.event << F("CMD: ") << cmdBuffer << endl;
+      // the transmit task is made ready by loop() when the command can be sent
+      // commands for the same device replace each other while they wait, unknown keys have no device
+      TransmitProfile profile;
+      pulseTrainManager.getProfile(cmdBuffer, &profile);
+      TransmitQueueResult result = transmitQueue.push(cmdBuffer, profile.device, millis());
+      if (result == TX_MERGED) {
+        output.event.println(F("MERGED")); // sent as part of a pending command for the same device
+      } else if (result == TX_FULL) {
+        output.event.println(F("FULL")); // dropped, the queue is full
+      }
+    }
+  }
+  return Serial.available() > 0;
+}
+
+/*
+  Task: transmits the pulse train of the command at the front of the transmit queue
+  Waits for a clear channel first (listen before talk) so we don't collide with a remote that is mid-transmit,
+  while waiting the task is made ready again by loop() every channelRetryDelay ms, so the other tasks carry on
+  running (the receiver carries on capturing the other transmission) and the mcu can sleep in between.
+  If the transmission would use more than the airtime left in the budget the command stays at the front
+  of the queue and the task is made ready again by loop() once enough of the airtime has expired.
+  @return false, the task is made ready again by loop() while there are commands waiting
+*/
+bool transmitPulseTrain() {
+  const char *key = transmitQueue.peek();
+  if (key == NULL) return false;
+  if (txWaitStart == 0) txWaitStart = millis();
+  if (receiver.channelBusy(clearChannelWindow) && (millis() - txWaitStart) < maxChannelWait) {
+    txRetryTime = millis();
+    return false;
+  }
+  txWaitStart = 0;
+  char txKey[CMDBUFFER_SIZE];
+  strcpy(txKey, key);
+  TransmitProfile txProfile;
+  // the pulse train is kept until the end of the function, the receiver compares its echo with it while it is sent
+  vector<int16_t> pulseTrain = pulseTrainManager.get(txKey, &txProfile);
+  if (pulseTrain.size() > 0) {
+    if (!transmitQueue.reserveAirtime(millis(), transmitter.estimateDuration(&pulseTrain, txProfile, repeatCount))) return false;
     #ifdef MEM_DEBUG
-      sout << F("detectedPulseTrain size: ") << detectedPulseTrain->size() << endl;
-      sout << F("Address of detectedPulseTrain: ") << (int)detectedPulseTrain << F(" (0x") << _HEX((int)detectedPulseTrain) << F(")") << endl;           
       PRINT_MEM
+      sout << F("Sending pulse train...") << endl;
     #endif
-    char key[6];
-    bool found = pulseTrainManager.findPulseTrain(detectedPulseTrain, key);
-    // Display the result
-    if (found) {
-      // Display the code
-      Serial.print(F("KEY: "));Serial.println(key);
+    // The receiver stays armed in echo mode, our own pulses are recognised and not captured but
+    // anything else still is, hearing the echo also confirms the transmission actually left the antenna
+    receiver.beginEcho(&pulseTrain, transmitter.getPreamble(txProfile));
+    transmitter.setIsrCorrection(receiver.getEchoIsrDuration());
+    transmitQueue.recordLatency(millis());
+    digitalWrite(ledPin, HIGH);
+    transmitter.send(&pulseTrain, txProfile, repeatCount);
+    digitalWrite(ledPin, LOW);
+    unsigned int echoMatches = receiver.endEcho();
+    // confirmed if at least half of the pulses in a single repeat were heard
+    if (echoMatches >= pulseTrain.size() / 2) {
+      echoConfirmedCount++;
     } else {
-      // Print the pulse train if in debug mode
-      #ifdef DEBUG
-        receiver.printDebug(Serial);
-        sout << endl;
-      #endif
+      echoMissedCount++;
     }
-    delete detectedPulseTrain; // Delete the allocated memory
-    // Start listening again...
+    output.event.println(F("OK"));
     #ifdef MEM_DEBUG
       PRINT_MEM
-      sout << endl;
     #endif
+    #ifdef DEBUG
+      printStats(transmitter);
+      output.debug << F("echo matched ") << echoMatches << F(" of ") << receiver.echoPulseCount << F(" pulses received") << endl;
+    #endif
+  } else {
+    output.event.println(F("?")); // Indicate that the command / pulsetrain key was not recognised
+  }
+  transmitQueue.pop();
+  return false;
+}
+
+/*
+  Task: takes the pulse train from the receiver and starts matching it
+  The receiver is restarted straight away unless in debug mode, where its buffer is needed by printPulseTrain
+  @return false, the task is made ready again by loop() when the next pulse train is available
+*/
+bool receivePulseTrain() {
+  if (receiver.endTime == 0 || !pulseTrainManager.isMatchComplete()) return false;
+  digitalWrite(ledPin, HIGH);
+  detectedPulseTrain = new vector<int16_t>; // Allocated on the heap
+  receiver.getPulseTrain(detectedPulseTrain);
+  #ifdef MEM_DEBUG
+    sout << F("detectedPulseTrain size: ") << detectedPulseTrain->size() << endl;
+    sout << F("Address of detectedPulseTrain: ") << (int)detectedPulseTrain << F(" (0x") << _HEX((int)detectedPulseTrain) << F(")") << endl;           
+    PRINT_MEM
+  #endif
+  #ifndef DEBUG
+    // Start listening again...
     receiver.startScanning();
+  #endif
+  captureTime = millis();
+  // A remote sends several repeats for each press, if the same key was captured recently only those keys need to be
+  // scored to find out if this is another repeat of it, which saves searching through the whole library
+  int recentIndexes[CAPTURE_HISTORY_SIZE];
+  byte recentCount = captureHistory.getRecentIndexes(captureTime, recentIndexes);
+  MatchResult match;
+  if (recentCount > 0 && pulseTrainManager.findPulseTrainIn(detectedPulseTrain, recentIndexes, recentCount, &match)) {
+    captureHistory.record(match, captureTime);
+    delete detectedPulseTrain;
+    detectedPulseTrain = NULL;
+    #ifdef DEBUG
+      receiver.startScanning();
+    #endif
+    digitalWrite(ledPin, LOW);
+    return false;
   }
+  pulseTrainManager.beginMatch(detectedPulseTrain);
+  scheduler.setReady(matchTask);
+  return false;
+}
 
-  if (event.serialDataReceived) {
-    digitalWrite(ledPin, HIGH);
-    sout << F("CMD: ") << cmdBuffer << endl;
-    vector<int16_t> *pulseTrain = &(pulseTrainManager.get(cmdBuffer));
-    if (pulseTrain->size() > 0) {
-      #ifdef MEM_DEBUG
-        PRINT_MEM
-        sout << F("Sending pulse train...") << endl;
-      #endif
-      // The recevier needs to be stopped to prevent receiving the pulseTrain that is about to be sent
-      receiver.stopScanning();
-      digitalWrite(ledPin, HIGH);
-      transmitter.send(pulseTrain, repeatCount);
-      digitalWrite(ledPin, LOW);
-      Serial.println(F("OK"));
-      // By using an explicit pointer for pulseTrain, the allocated memory is free'd by the time this point is reached
-      // If an implicit const pointer was used, memory was not free'd until outside of the if block 
-      #ifdef MEM_DEBUG
-        PRINT_MEM
-      #endif
-      #ifdef DEBUG
-        printStats(transmitter);
-      #endif
+/*
+  Task: matches the received pulse train against the stored pulse trains, one time slice per run
+  @return true until the match is complete
+*/
+bool matchPulseTrain() {
+  MatchResult match;
+  #ifdef PULSE_TRIE
+    // a single traversal of the trie, this is not time sliced
+    // the stack it uses does not depend on the pulse train so it is only measured once, shown by the MEM command
+    if (trieStackSize == 0) memoryMonitor.beginStackMeasure();
+    bool found = pulseTrainManager.findPulseTrainTrie(detectedPulseTrain, &match);
+    if (trieStackSize == 0) trieStackSize = memoryMonitor.endStackMeasure();
+  #else
+    if (!pulseTrainManager.continueMatch(matchTimeSlice)) return true;
+    bool found = pulseTrainManager.getMatchResult(&match);
+  #endif
+  // Display the result
+  // Only a new press is displayed, a repeat of a recent press is counted and reported by reportRepeats
+  if (found && captureHistory.record(match, captureTime)) {
+    // Display the code
+    output.event << F("KEY: ") << match.key << endl;
+    #ifdef DEBUG
+      output.debug << F("confidence: ") << match.confidence << F("% margin: ") << match.margin << F("%") << endl;
+    #endif
+  }
+  delete detectedPulseTrain; // Delete the allocated memory
+  detectedPulseTrain = NULL;
+  #ifdef MEM_DEBUG
+    PRINT_MEM
+    sout << endl;
+  #endif
+  #ifdef DEBUG
+    // Print the pulse train if in debug mode, the receiver is restarted once it has been printed
+    if (found) {
       receiver.startScanning();
     } else {
-      Serial.println(F("?")); // Indicate that the command / pulsetrain key was not recognised
+      scheduler.setReady(debugTask);
     }
+  #endif
+  digitalWrite(ledPin, LOW);
+  return false;
+}
+
+/*
+  Task: reports the number of times each press was captured once its hold-off window has ended
+  Prints RPT: followed by the key and the count (including the first capture which was reported by KEY:)
+  @return false, the task is made ready again by loop() when there is another press to report
+*/
+bool reportRepeats() {
+  CaptureHistoryEntry entry;
+  while (captureHistory.removeExpired(millis(), &entry)) {
+    output.event << F("RPT: ") << entry.key << F(" ") << entry.repeatCount << endl;
   }
-  // Pause for debugging
-  //while (true) {}
+  return false;
+}
+
+/*
+  Task: prints the unmatched pulse train from the receiver's buffer then starts listening again
+  Each line is only printed once there is room for it in the debug output so none of it is dropped
+  @return true until all of the lines have been printed
+*/
+bool printPulseTrain() {
+  while (output.debug.space() >= DEBUG_LINE_MAX) {
+    debugLine = receiver.printDebug(output.debug, debugLine);
+    if (debugLine == 0) {
+      output.debug.println();
+      receiver.startScanning();
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  Task: moves the buffered output into the serial port's transmit buffer
+  @return false, the task is made ready again by loop() while there is output waiting and room in the serial port
+*/
+bool writeOutput() {
+  output.drain();
+  return false;
+}
+
+/*
+  Puts the mcu into idle sleep until an interrupt occurs, rather than spinning around loop()
+  The receiver pin interrupts, the serial port receive interrupt and the timer interrupts
+  (Timer0 for millis() every 1ms, Timer2 overflow every 128us) all wake it up again.
+  Idle mode is used as the other sleep modes stop the serial port and timers.
+*/
+void waitForEvent() {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  noInterrupts();
+  // check with interrupts disabled so an event occurring after the check can't be slept through
+  if (receiver.endTime == 0 && Serial.available() == 0) {
+    sleep_enable();
+    interrupts(); // the instruction after sei is always executed before a pending interrupt, so sleep_cpu is reached
+    sleep_cpu();
+    sleep_disable();
+  }
+  interrupts();
 }
 
 void printStats(Transmitter &transmitter) {
-      sout << F("sent ") << transmitter.pulseCount << F(" pulses repeated ") << repeatCount <<  F(" times") << endl;
-      sout << F("total duration ") << transmitter.totalDuration << F("us") << endl;
-      sout << F("each pulse train sent in ") << transmitter.duration << F("us") << endl;
+      output.debug << F("sent ") << transmitter.pulseCount << F(" pulses repeated ") << transmitter.repeatCount <<  F(" times") << endl;
+      output.debug << F("total duration ") << transmitter.totalDuration << F("us") << endl;
+      output.debug << F("each pulse train sent in ") << transmitter.duration << F("us") << endl;
+}
+
+/*
+  Calibrates the transmitter's timing corrections using the receiver
+  The test pattern is transmitted with the receiver in echo mode, the average error of the high and low
+  pulses it hears is added to the transmitter's corrections and this is repeated to refine them.
+  The receiver needs to be close enough to the transmitter to hear it clearly (eg. on the same board).
+  The measured error includes the receiver module's own rise / fall asymmetry, this can't be separated from
+  the transmitter's, but the same receiver type is used to capture the pulse trains in the first place.
+  The corrections are saved to EEPROM and loaded at startup, the previous corrections are kept if it fails.
+  The calibration is sent like any other transmission: it waits for a clear channel (listen before talk, blocking
+  as the calibration already does) and its airtime is taken out of the budget, it fails if there is not enough left.
+*/
+void calibrateTransmitter() {
+  vector<int16_t> pattern;
+  int patternSize = sizeof(calibrationPattern) / sizeof(int16_t);
+  pattern.reserve(patternSize);
+  for (int i = 0; i < patternSize; i++) {
+    pattern.push_back(pgm_read_word_near(&calibrationPattern[i]));
+  }
+  int highCorrection = transmitter.getHighCorrection();
+  int lowCorrection = transmitter.getLowCorrection();
+  output.flush(); // the results are printed straight to the serial port
+  TransmitProfile defaults = { 0, 0, 0, 0 };
+  if (!transmitQueue.useAirtime(millis(), transmitter.estimateDuration(&pattern, defaults, calibrationRepeatCount) * calibrationRounds)) {
+    sout << F("CALIB FAIL airtime used: ") << transmitQueue.getAirtimeUsed(millis()) << F("ms") << endl;
+    return;
+  }
+  unsigned long waitStart = millis();
+  while (receiver.channelBusy(clearChannelWindow) && (millis() - waitStart) < maxChannelWait) {
+    delay(channelRetryDelay);
+  }
+  digitalWrite(ledPin, HIGH);
+  for (byte round = 0; round < calibrationRounds; round++) {
+    receiver.beginEcho(&pattern, initialPulse);
+    transmitter.setIsrCorrection(receiver.getEchoIsrDuration());
+    transmitter.send(&pattern, calibrationRepeatCount);
+    receiver.endEcho();
+    int highError, lowError;
+    if (!receiver.getEchoTimingError(&highError, &lowError)) {
+      digitalWrite(ledPin, LOW);
+      transmitter.setCorrection(highCorrection, lowCorrection);
+      sout << F("CALIB FAIL echo matched ") << receiver.echoMatchCount << F(" of ") << receiver.echoPulseCount << endl;
+      return;
+    }
+    #ifdef DEBUG
+      sout << F("round ") << round << F(" error high: ") << highError << F("us low: ") << lowError << F("us") << endl;
+    #endif
+    // a pulse received too long means the delay for that polarity needs to be shortened
+    transmitter.setCorrection(transmitter.getHighCorrection() + highError, transmitter.getLowCorrection() + lowError);
+  }
+  digitalWrite(ledPin, LOW);
+  transmitter.saveCorrection(calibrationAddress);
+  sout << F("CALIB high: ") << transmitter.getHighCorrection()
+       << F("us low: ") << transmitter.getLowCorrection() << F("us") << endl;
+}
+
+// Prints the always-on performance counters, requested with the STATS command
+void printPerformanceStats() {
+      // printed straight to the serial port after any buffered output
+      output.flush();
+      sout << F("STATS") << endl;
+      receiver.printStats(Serial);
+      pulseTrainManager.printStats(Serial);
+      sout << F("tx count: ") << transmitter.sendCount << F(" last: ") << transmitter.totalDuration
+           << F("us max: ") << transmitter.maxTotalDuration << F("us") << endl;
+      transmitQueue.printStats(Serial, millis());
+      sout << F("tx echo confirmed: ") << echoConfirmedCount << F(" missed: ") << echoMissedCount << endl;
+      sout << F("tx correction high: ") << transmitter.getHighCorrection()
+           << F("us low: ") << transmitter.getLowCorrection() << F("us") << endl;
+      captureHistory.printStats(Serial);
+      output.printStats(Serial);
+      scheduler.printStats(Serial);
+}
+
+/*
+  Prints the worst case SRAM use since boot and the sizes of the main buffers (fixed at compile time)
+*/
+void printMemoryStats() {
+      // printed straight to the serial port after any buffered output
+      output.flush();
+      sout << F("MEM") << endl;
+      memoryMonitor.printStats(Serial);
+      sout << F("buffers receiver: ") << sizeof(receiver.timings)
+           << F(" output: ") << (outputEventSize + outputDebugSize)
+           << F(" scheduler: ") << sizeof(scheduler)
+           << F(" history: ") << sizeof(captureHistory)
+           << F(" tx queue: ") << sizeof(transmitQueue)
+           << F(" match counts: ") << (pulseTrainArraySize + pwmPulseTrainArraySize) * sizeof(unsigned int) << endl;
+      #ifdef PULSE_TRIE
+        sout << F("trie search stack: ") << trieStackSize << endl;
+      #endif
 }
 
 // Interrupt Service Routine (ISR) for when Timer2's counter overflows;
@@ -4,6 +4,7 @@
   Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
 */
 #include "Receiver.h"
+#include "Macros.h"
 //#include <climits>
 #include <limits.h>
 
@@ -19,10 +20,10 @@ Receiver *Receiver::_instance = NULL;
 */
 Receiver::Receiver(TimerBase *timer, int pinA, int pinB, int ledPin) :
             _timer(timer),
+             _ledPin(ledPin),
              _pinA(pinA),
              _pinB(pinB),
-             _ledPin(ledPin),
-             _rfStartPulseDuration(5000), // minimum pulse width to detect start of rf pulse train (microseconds)
+             _rfStartPulseDuration(SYNC_GAP_MIN_DURATION), // minimum pulse width to detect start of rf pulse train (microseconds)
              _rfPulseCountMin(25), // minimum number of pulses between start and radio silence to be considered valid
              _rfPulseCountMax(0), // minimum number of pulses between start and radio silence to be considered valid
              _rfSilenceDuration(20000) // minimum pulse width to detect radio silence signifying end of transmission (microseconds)
@@ -36,7 +37,17 @@ Receiver::Receiver(TimerBase *timer, int pinA, int pinB, int ledPin) :
 void Receiver::configure()
 {
   _ledstate = LOW;
-  _counter = 0;
+  _ledCycleStart = 0;
+  edgeCount = 0;
+  droppedEdgeCount = 0;
+  isrTotalTicks = 0;
+  isrMaxTicks = 0;
+  acceptedCount = 0;
+  rejectedCount = 0;
+  echoEdgeCount = 0;
+  echoIsrTotalTicks = 0;
+  _lastSyncTime = 0;
+  _echoPulseTrain = NULL;
   resetIsrVariables();
   
   _interruptNum1 = digitalPinToInterrupt(_pinA);
@@ -50,20 +61,22 @@ void Receiver::configure()
   Checks if a pulse train is available
   Blinks the LED while we are waiting of pulses to be detected...
   Needs to be called repeatedly until the function returns a non zero result
-  @ledOff the _counter value at which the LED is turned off
-  @ledOn the _counter value at which the LED is turned on
+  The LED timing is based on millis() so it does not depend on how often this is called
+  @ledOnDuration the number of milliseconds the LED is on for in each flash
+  @ledPeriod the number of milliseconds between the start of each flash
   @return number of pulses detected
 */
-unsigned long Receiver::available(unsigned int ledOff, unsigned int ledOn) {
+unsigned long Receiver::available(unsigned int ledOnDuration, unsigned int ledPeriod) {
   if (endTime == 0) {
-    if (_counter == ledOff && _ledstate == HIGH) {
-      _ledstate = LOW;
-      digitalWrite(_ledPin, _ledstate);
-    } else if (_counter == ledOn && _ledstate == LOW) {
-      _ledstate = HIGH;
+    unsigned long elapsed = millis() - _ledCycleStart;
+    if (elapsed >= ledPeriod) {
+      _ledCycleStart += elapsed; // start the next flash
+      elapsed = 0;
+    }
+    bool ledstate = (elapsed < ledOnDuration);
+    if (ledstate != _ledstate) {
+      _ledstate = ledstate;
       digitalWrite(_ledPin, _ledstate);
-    } else {
-      _counter++; // _counter is allowed to overflow
     }
     return 0;
   } else {
@@ -109,41 +122,201 @@ void Receiver::getPulseTrain(vector<int16_t> *pulseTrain) {
 }
 
 /*
-  Prints the pulse train debug information to the specified serial port
-  @port the serial port to use
+  Prints a line of the details of the last capture and the captured pulse train for debugging
+  The output is split into lines so that it can be written to a buffered output a line at a time (refer to OutputQueue),
+  each line is at most DEBUG_LINE_MAX characters. The pulse train buffer is printed DEBUG_VALUES_PER_LINE values per line,
+  the lines can still be pasted straight into ProgMemGlobals.cpp
+  @port where to print
+  @line the line to print, starting from 0
+  @return the next line to print, 0 once all of the lines have been printed
 */
-void Receiver::printDebug(HardwareSerial &port) {
-  digitalWrite(_ledPin, HIGH);
-  port.println();
-  port.println(F("scan result:"));
-  port.print(F("listening duration: ")); port.print(endTime - startTime);port.println(F(" ms"));
-  port.print(F("detection duration: ")); port.print(endTime - detectionStartTime);port.println(F(" ms"));
-  port.print(F("buffer overflow count: ")); port.println(overflowCount);
-
+unsigned int Receiver::printDebug(Print &port, unsigned int line) {
   unsigned int startIndex = 0;
   // if the butter has overflowed, start at the correct location in the buffer
   if (overflowCount > 0) startIndex = pos+1;
-  port.print(F("buffer start index: ")); port.print(startIndex);port.print(F(" starting state: ")); port.println(startingState);
-  port.print(F("pulse train count: ")); port.print(rfPulseCount);port.print(F(" pulse train duration: ")); port.print(rfPulseTrainDuration);port.println(F(" us"));
-  port.println(F("pulse train buffer:"));
-  // Print from startIndex to end of buffer
-  for (unsigned int i = startIndex; i < SAMPLESIZE; i++) {
-    //port.print( boolToDisplay(values[i]) );
-    port.print( timings[i] );
-    port.print(",");
+  switch (line) {
+    case 0:
+      digitalWrite(_ledPin, HIGH);
+      port.println();
+      break;
+    case 1:
+      port.println(F("scan result:"));
+      break;
+    case 2:
+      port.print(F("listening duration: ")); port.print(endTime - startTime);port.println(F(" ms"));
+      break;
+    case 3:
+      port.print(F("detection duration: ")); port.print(endTime - detectionStartTime);port.println(F(" ms"));
+      break;
+    case 4:
+      port.print(F("buffer overflow count: ")); port.println(overflowCount);
+      break;
+    case 5:
+      port.print(F("buffer start index: ")); port.print(startIndex);port.print(F(" starting state: ")); port.println(startingState);
+      break;
+    case 6:
+      port.print(F("pulse train count: ")); port.print(rfPulseCount);port.print(F(" pulse train duration: ")); port.print(rfPulseTrainDuration);port.println(F(" us"));
+      break;
+    case 7:
+      port.println(F("pulse train buffer:"));
+      break;
+    default:
+      // Print from startIndex to the end of the buffer and then from zero to startIndex if overflowed
+      unsigned int first = (line - 8) * DEBUG_VALUES_PER_LINE;
+      for (unsigned int i = first; i < first + DEBUG_VALUES_PER_LINE && i < SAMPLESIZE; i++) {
+        unsigned int index = startIndex + i;
+        if (index >= SAMPLESIZE) index -= SAMPLESIZE;
+        port.print( timings[index] );
+        port.print(",");
+      }
+      port.println();
+      if (first + DEBUG_VALUES_PER_LINE >= SAMPLESIZE) {
+        digitalWrite(_ledPin, LOW);
+        return 0;
+      }
   }
-  // If overflowed print from zero to startIndex
-  if (overflowCount > 0) {
-    for (unsigned int i = 0; i < startIndex; i++) {
-      //port.print( boolToDisplay(values[i]) );
-      port.print( timings[i] );
-      port.print(",");
-    }
+  return line + 1;
+}
+
+
+/*
+  Prints the performance counters in a compact form to the specified serial port
+  The ISR timings are converted from timer ticks (0.5us) to cpu cycles, the edges of our own transmission
+  are averaged separately as they take a different path through the ISR
+  @port the serial port to use
+*/
+void Receiver::printStats(HardwareSerial &port) {
+  noInterrupts(); // take a consistent copy of the counters updated by the ISR's
+  unsigned long edges = edgeCount;
+  unsigned long dropped = droppedEdgeCount;
+  unsigned long echoEdges = echoEdgeCount;
+  unsigned long totalTicks = isrTotalTicks;
+  unsigned long echoTicks = echoIsrTotalTicks;
+  unsigned int maxTicks = isrMaxTicks;
+  unsigned int accepted = acceptedCount;
+  unsigned int rejected = rejectedCount;
+  interrupts();
+  const unsigned long cyclesPerTick = F_CPU / 2000000UL;
+  unsigned long capturedEdges = edges - dropped - echoEdges;
+  port.print(F("edges: ")); port.print(edges);
+  port.print(F(" dropped: ")); port.print(dropped);
+  port.print(F(" echo: ")); port.println(echoEdges);
+  port.print(F("isr cycles max: ")); port.print(maxTicks * cyclesPerTick);
+  port.print(F(" avg: ")); port.print(capturedEdges > 0 ? (totalTicks * cyclesPerTick) / capturedEdges : 0);
+  port.print(F(" echo avg: ")); port.println(echoEdges > 0 ? (echoTicks * cyclesPerTick) / echoEdges : 0);
+  port.print(F("captures accepted: ")); port.print(accepted);
+  port.print(F(" rejected: ")); port.println(rejected);
+  port.print(F("timer jitter: ")); port.println(_timer->getJitterCount());
+}
+
+/*
+  Checks if another device appears to be transmitting, used to listen before transmitting
+  Pulse trains are repeated several times separated by sync gaps, so the channel is busy
+  if a sync gap was seen recently. The receiver's noise between transmissions is made up of
+  short pulses so does not affect the result.
+  Only works while scanning, the channel is always reported clear while a capture is waiting
+  @window milliseconds since the last sync gap for which the channel is considered busy
+  @return true if the channel is busy
+*/
+bool Receiver::channelBusy(unsigned int window) {
+  if (endTime != 0) return false;
+  noInterrupts();
+  unsigned long lastSyncTime = _lastSyncTime;
+  interrupts();
+  return lastSyncTime != 0 && (millis() - lastSyncTime) < window;
+}
+
+/*
+  Starts echo mode, used while transmitting so the receiver stays armed without capturing our own transmission
+  In echo mode each received pulse is first compared with the pulse train being sent, the pulses which match
+  are our own and are not captured (hearing them also confirms that the transmission left the antenna),
+  the pulses which don't match carry on into the capture as usual so another device's transmission is still captured.
+  How much of another transmission gets through depends on how strong it is compared to our own.
+  If a capture is waiting to be matched it is kept, there is nowhere to put a new one until it has been taken.
+  @pulseTrain the pulse train about to be sent, must not be modified until endEcho is called
+  @preamble the initial high pulse sent before the pulse train in microseconds, it is also our own
+*/
+void Receiver::beginEcho(vector<int16_t> *pulseTrain, int16_t preamble) {
+  noInterrupts();
+  _echoPulseTrain = pulseTrain;
+  _echoIndex = 0;
+  _echoPreamble = preamble;
+  echoPulseCount = 0;
+  echoMatchCount = 0;
+  _echoHighError = 0;
+  _echoLowError = 0;
+  _echoHighCount = 0;
+  _echoLowCount = 0;
+  interrupts();
+  if (endTime != 0) {
+    // the interrupts are detached while a capture is waiting to be matched
+    _prevTime = 0;
+    _instance = this;
+    attachInterrupt(_interruptNum1, handleInterruptRising, RISING);
+    attachInterrupt(_interruptNum2, handleInterruptFalling, FALLING);
   }
-  port.println();
-  digitalWrite(_ledPin, LOW);
 }
 
+/*
+  Ends echo mode, the receiver carries on with any capture started during the transmission
+  If a capture was waiting to be matched when echo mode started, or one was completed during the transmission,
+  the receiver is stopped again until it has been taken
+  @return the number of received pulses which matched the pulse train that was sent
+*/
+unsigned int Receiver::endEcho() {
+  noInterrupts();
+  _echoPulseTrain = NULL;
+  interrupts();
+  if (endTime != 0) {
+    detachInterrupt(_interruptNum1);
+    detachInterrupt(_interruptNum2);
+  }
+  return echoMatchCount;
+}
+
+/*
+  Gets the average timing error of the pulses received during the last echo mode
+  The error is the received pulse duration minus the sent pulse duration for each of the matched pulses,
+  it includes the transmitter's execution overhead and the rise / fall asymmetry of both radio modules
+  @highError out parameter, average error of the high pulses in microseconds
+  @lowError out parameter, average error of the low pulses in microseconds
+  @return true if enough pulses of each polarity were matched for the averages to be meaningful
+*/
+bool Receiver::getEchoTimingError(int *highError, int *lowError) {
+  noInterrupts();
+  long highTotal = _echoHighError;
+  long lowTotal = _echoLowError;
+  unsigned int highCount = _echoHighCount;
+  unsigned int lowCount = _echoLowCount;
+  interrupts();
+  if (highCount < 8 || lowCount < 8) return false;
+  *highError = highTotal / (long)highCount;
+  *lowError = lowTotal / (long)lowCount;
+  return true;
+}
+
+/*
+  Gets the time the ISR takes to handle an edge of our own transmission, the transmitter's pulses are lengthened by it
+  as the receiver hears each edge part way through the pulse. Before anything has been sent, the time taken to
+  capture an edge is used instead (the receiver's noise is captured between transmissions).
+  @return the average time in microseconds, including ISR_ENTRY_EXIT_CYCLES
+*/
+int Receiver::getEchoIsrDuration() {
+  noInterrupts();
+  unsigned long echoEdges = echoEdgeCount;
+  unsigned long echoTicks = echoIsrTotalTicks;
+  unsigned long capturedEdges = edgeCount - droppedEdgeCount - echoEdgeCount;
+  unsigned long totalTicks = isrTotalTicks;
+  interrupts();
+  unsigned long ticks = 0;
+  if (echoEdges > 0) {
+    ticks = echoTicks / echoEdges;
+  } else if (capturedEdges > 0) {
+    ticks = totalTicks / capturedEdges;
+  }
+  const unsigned long cyclesPerTick = F_CPU / 2000000UL;
+  return (ticks * cyclesPerTick + ISR_ENTRY_EXIT_CYCLES) / (F_CPU / 1000000UL);
+}
 
 /*
   start scanning for pulses on the pins
@@ -226,6 +399,15 @@ void Receiver::handleInterruptFalling() {
   _instance->processStateChange(false);
 }
 
+/*
+  Feeds a state change into the capture logic as if it had come from the receiver's ISR's
+  Used by the host benchmark together with a simulated TimerBase to replay synthetic signals
+  @edgeState true for a rising edge
+*/
+void Receiver::injectStateChange(bool edgeState) {
+  processStateChange(edgeState);
+}
+
 /* 
   Common function to process the state changes detected in each ISR
   If edgeState = true we are processing a rising edge
@@ -234,10 +416,22 @@ void Receiver::handleInterruptFalling() {
   smaller pulse widths will be recorded as the minimum duration it takes to execute the code
 */
 void Receiver::processStateChange(bool edgeState) {
-  // protection from processing a pending interrupt if a flag was set just before detachInterrupts() was called
-  if (endTime != 0) return;
+  edgeCount++;
   //const unsigned long time = micros(); // can use this instead of hardware timer, only accurate to nearest 4us
   const unsigned long time = _timer->getCount(); //timer is more accurate then using the micros function
+  if (_echoPulseTrain != NULL) {
+    // our own pulses are not captured, nor is anything else while a capture is waiting to be taken
+    if ((_prevTime > 0 && processEcho(edgeState, (time - _prevTime) / 2)) || endTime != 0) {
+      _prevTime = time;
+      echoEdgeCount++;
+      echoIsrTotalTicks += (byte)(_timer->getTicks() - (byte)time);
+      return;
+    }
+  } else if (endTime != 0) {
+    // protection from processing a pending interrupt if a flag was set just before detachInterrupts() was called
+    droppedEdgeCount++;
+    return;
+  }
   //Serial.println(time);
   if (_prevTime > 0) {
     unsigned long duration = (time - _prevTime) / 2;
@@ -249,17 +443,27 @@ void Receiver::processStateChange(bool edgeState) {
       _pulseTrainStartDetected = true;
       detectionStartTime = millis();
     }
+    if (duration > _rfStartPulseDuration && duration < _rfSilenceDuration) {
+      _lastSyncTime = millis();
+    }
     if (_pulseTrainStartDetected == true) {
-      if (duration > INT_MAX) {
-        //__INT_MAX__ is not defined in limits.h or config.h
-        // as result it causes an intelliSense error when using INT_MAX which is defined as __INT_MAX__
-        duration = INT_MAX;
+      if (duration > INT16_MAX) {
+        // capped at the 16bit maximum explicitly rather than using INT_MAX so that the
+        // captured values are the same on hardware where int is larger (such as the host build)
+        duration = INT16_MAX;
       }
       // Detect rf silence (low pulse), ignore unless more than 2 pulses detected 
       if (edgeState && (duration > _rfSilenceDuration)) {
         if (rfPulseCount > _rfPulseCountMin && ((rfPulseCount < _rfPulseCountMax) || _rfPulseCountMax == 0)) {
-          detachInterrupts(); // Valid pulse train detected
+          // Valid pulse train detected, while in echo mode the interrupts are detached by endEcho
+          if (_echoPulseTrain == NULL) {
+            detachInterrupts();
+          } else {
+            endTime = millis();
+          }
+          acceptedCount++;
         } else {
+          rejectedCount++;
           resetPulseTrainCapture();
           startTime = millis() - duration;
         }
@@ -287,6 +491,50 @@ void Receiver::processStateChange(bool edgeState) {
     }
   }
   _prevTime = time;
+  // timed from the count read above using only the hardware counter, another getCount() would add to the
+  // time being measured and to the timer jitter count
+  byte ticks = _timer->getTicks() - (byte)time;
+  isrTotalTicks += ticks;
+  if (ticks > isrMaxTicks) isrMaxTicks = ticks;
+}
+
+/*
+  Compares a pulse received in echo mode with the pulse train being sent
+  The expected pulse and the one after it are checked, allowing for an edge being missed,
+  the initial pulse sent by the transmitter is matched separately as it is not part of the pulse train
+  @edgeState true for a rising edge (the end of a low pulse)
+  @duration the pulse duration in microseconds
+  @return true if the pulse is our own
+*/
+bool Receiver::processEcho(bool edgeState, unsigned long duration) {
+  echoPulseCount++;
+  int size = _echoPulseTrain->size();
+  if (size == 0 || duration > INT16_MAX) return false;
+  int16_t pulse = edgeState ? -(int16_t)duration : (int16_t)duration;
+  if (_echoPreamble != 0 && pulse > _echoPreamble - pulseTolerance(_echoPreamble) &&
+      pulse < _echoPreamble + pulseTolerance(_echoPreamble)) {
+    _echoPreamble = 0; // only sent once, before the first repeat
+    return true;
+  }
+  for (byte i = 0; i < 2; i++) {
+    unsigned int index = _echoIndex + i;
+    if (index >= (unsigned int)size) index -= size; // the pulse train is repeated
+    int16_t expected = (*_echoPulseTrain)[index];
+    int16_t tolerance = pulseTolerance(expected);
+    if (pulse > expected - tolerance && pulse < expected + tolerance) {
+      echoMatchCount++;
+      if (pulse > 0) {
+        _echoHighError += pulse - expected;
+        _echoHighCount++;
+      } else {
+        _echoLowError += expected - pulse; // the low pulses are negative
+        _echoLowCount++;
+      }
+      _echoIndex = index + 1 < (unsigned int)size ? index + 1 : 0;
+      return true;
+    }
+  }
+  return false;
 }
 
 // Destructor
@@ -31,9 +31,18 @@ using std::vector;
   using 300 can result in crash due to heap and stack collision
   serial port uses 186 bytes and additional space is required for extracting pulses
   from the buffer and comparing to stored pulsetrains etc. 
+  Send the MEM command after changing it to check the worst case free memory between the heap and the stack
 */
 #define SAMPLESIZE 250 
 
+// Number of pulses printed on each line of the pulse train buffer by printDebug
+#define DEBUG_VALUES_PER_LINE 12
+// Longest line printed by printDebug (12 pulses of up to 6 characters plus a comma each, and the line ending)
+#define DEBUG_LINE_MAX 86
+// Approximate cpu cycles taken to enter and leave the ISR's through attachInterrupt's handler (saving and restoring
+// the registers and the calls into the class), about 5us at 16Mhz, not included in the measured ISR times
+#define ISR_ENTRY_EXIT_CYCLES 80
+
 class Receiver
 {
   public:
@@ -50,14 +59,33 @@ class Receiver
     volatile unsigned long rfPulseTrainDuration;
     volatile byte startingState; // We need a tri state bool value here so use byte instead
     volatile byte prevState;
+
+    // Performance counters, these are kept since boot and are not reset by each capture
+    volatile unsigned long edgeCount; // edges processed by the ISR's
+    volatile unsigned long droppedEdgeCount; // edges ignored because a capture had already completed
+    volatile unsigned long isrTotalTicks; // total timer ticks spent capturing in processStateChange, used for the average
+    volatile unsigned int isrMaxTicks; // longest time spent in processStateChange in timer ticks
+    volatile unsigned int acceptedCount; // pulse trains which ended with radio silence and a valid pulse count
+    volatile unsigned int rejectedCount; // pulse trains which ended with radio silence but too few pulses
+    volatile unsigned int echoPulseCount; // pulses received while echo mode was active
+    volatile unsigned int echoMatchCount; // pulses received in echo mode which matched the pulse train being sent
+    volatile unsigned long echoEdgeCount; // edges of our own transmission handled by the echo, not included in isrTotalTicks
+    volatile unsigned long echoIsrTotalTicks; // total timer ticks spent handling the edges of our own transmission
     
     static Receiver *_instance; // A pointer to the class instance so the ISR's can call into the class instance
     void configure();
     void startScanning();
     void stopScanning();
-    unsigned long available(unsigned int ledOff, unsigned int ledOn); //intervals for the LED flash
+    unsigned long available(unsigned int ledOnDuration, unsigned int ledPeriod); // LED flash timings in milliseconds
     void getPulseTrain(vector<int16_t> *pulseTrain);
-    void printDebug(HardwareSerial &port);
+    unsigned int printDebug(Print &port, unsigned int line);
+    void printStats(HardwareSerial &port);
+    void injectStateChange(bool edgeState);
+    bool channelBusy(unsigned int window);
+    void beginEcho(vector<int16_t> *pulseTrain, int16_t preamble);
+    unsigned int endEcho();
+    bool getEchoTimingError(int *highError, int *lowError);
+    int getEchoIsrDuration();
     
     // Destructor
     ~Receiver();
@@ -70,13 +98,22 @@ class Receiver
     int _interruptNum1;
     int _interruptNum2;
     bool _ledstate;
-    unsigned int _counter; // Used for tracking the led flash
-    const int _rfStartPulseDuration; // minimum pulse width to detect start of rf pulse train (microseconds)
+    unsigned long _ledCycleStart; // millis() value at the start of the current led flash
+    const unsigned int _rfStartPulseDuration; // minimum pulse width to detect start of rf pulse train (microseconds)
     const unsigned int _rfPulseCountMin; // minimum number of pulses between start and radio silence to be considered valid
     const unsigned int _rfPulseCountMax; // minimum number of pulses between start and radio silence to be considered valid
-    const int _rfSilenceDuration; // minimum pulse width to detect radio silence signifying end of transmission (microseconds)
+    const unsigned int _rfSilenceDuration; // minimum pulse width to detect radio silence signifying end of transmission (microseconds)
     volatile bool _pulseTrainStartDetected;
     volatile unsigned long _prevTime;
+    volatile unsigned long _lastSyncTime; // millis() when the last sync gap was seen, used for listen before talk
+    vector<int16_t> * volatile _echoPulseTrain; // the pulse train being transmitted while in echo mode
+    volatile unsigned int _echoIndex; // index of the next pulse expected in _echoPulseTrain
+    volatile int16_t _echoPreamble; // the initial high pulse sent before the pulse train, 0 once it has been heard
+    // Timing errors (received - sent) of the pulses matched in echo mode, used for calibrating the transmitter
+    volatile long _echoHighError;
+    volatile long _echoLowError;
+    volatile unsigned int _echoHighCount;
+    volatile unsigned int _echoLowCount;
   
     void attachInterrupts();
     void resetIsrVariables();
@@ -93,6 +130,7 @@ class Receiver
     static void handleInterruptFalling();
 
     void processStateChange(bool edgeState);
+    bool processEcho(bool edgeState, unsigned long duration);
 };
 
 #endif
@@ -0,0 +1,117 @@
+/*
+  File: Scheduler.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+*/
+#include "Scheduler.h"
+
+// Constructor
+Scheduler::Scheduler() : _taskCount(0) {}
+
+/*
+  Adds a task to the scheduler, the task is not ready until setReady is called
+  @function the task function
+  @priority tasks with a higher priority are run first
+  @name the name displayed by printStats (a flash string)
+  @return the task id used by the other functions, 255 if there is no room for the task
+*/
+byte Scheduler::addTask(TaskFunction function, byte priority, const __FlashStringHelper *name)
+{
+  if (_taskCount >= SCHEDULER_MAX_TASKS) return 255;
+  Task &task = _tasks[_taskCount];
+  task.function = function;
+  task.priority = priority;
+  task.ready = false;
+  task.name = name;
+  task.readyTime = 0;
+  task.maxLatency = 0;
+  task.maxRunTime = 0;
+  return _taskCount++;
+}
+
+/*
+  Marks a task as ready to run, the latency is timed from the first call until the task is run
+  Safe to call on a task which is already ready
+  @task the task id returned by addTask
+*/
+void Scheduler::setReady(byte task)
+{
+  if (task >= _taskCount || _tasks[task].ready) return;
+  _tasks[task].ready = true;
+  _tasks[task].readyTime = micros();
+}
+
+/*
+  @task the task id returned by addTask
+  @return true if the task is waiting to be run
+*/
+bool Scheduler::isReady(byte task)
+{
+  return task < _taskCount && _tasks[task].ready;
+}
+
+/*
+  Runs the highest priority task which is ready, needs to be called repeatedly from loop()
+  Tasks with equal priority are run in the order they were added
+  A task which returns true stays ready but its latency is only measured from when it was first made ready
+  @return false if there were no tasks ready to run
+*/
+bool Scheduler::run()
+{
+  Task *next = NULL;
+  for (byte i = 0; i < _taskCount; i++) {
+    if (_tasks[i].ready && (next == NULL || _tasks[i].priority > next->priority)) {
+      next = &_tasks[i];
+    }
+  }
+  if (next == NULL) return false;
+  unsigned long startTime = micros();
+  if (next->readyTime != 0) {
+    unsigned long latency = startTime - next->readyTime;
+    if (latency > next->maxLatency) next->maxLatency = latency;
+    next->readyTime = 0;
+  }
+  next->ready = false; // cleared first so the task can make itself ready again
+  bool moreWork = next->function();
+  unsigned long runTime = micros() - startTime;
+  if (runTime > next->maxRunTime) next->maxRunTime = runTime;
+  if (moreWork) next->ready = true;
+  return true;
+}
+
+/*
+  @task the task id returned by addTask
+  @return the longest time in microseconds from the task being made ready to it being run
+*/
+unsigned long Scheduler::getMaxLatency(byte task)
+{
+  return task < _taskCount ? _tasks[task].maxLatency : 0;
+}
+
+/*
+  @task the task id returned by addTask
+  @return the longest time in microseconds spent in a single run of the task
+*/
+unsigned long Scheduler::getMaxRunTime(byte task)
+{
+  return task < _taskCount ? _tasks[task].maxRunTime : 0;
+}
+
+/*
+  Prints the worst case latency and run time of each task in a compact form
+  @port the serial port to use
+*/
+void Scheduler::printStats(HardwareSerial &port)
+{
+  for (byte i = 0; i < _taskCount; i++) {
+    port.print(F("task ")); port.print(_tasks[i].name);
+    port.print(F(" wait max: ")); port.print(_tasks[i].maxLatency);
+    port.print(F("us run max: ")); port.print(_tasks[i].maxRunTime); port.println(F("us"));
+  }
+}
+
+// Destructor
+Scheduler::~Scheduler()
+{
+  // nothing to destruct here
+}
@@ -0,0 +1,64 @@
+/*
+  File: Scheduler.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+  
+  A small cooperative task scheduler
+  Tasks are functions which do a bounded amount of work each time they are called,
+  the highest priority task which is ready is run on each call to run()
+
+  Refer to cpp file for function descriptions and more info
+*/
+#ifndef Scheduler_h
+#define Scheduler_h
+
+#include "Arduino.h"
+
+// Maximum number of tasks, each task uses 18 bytes of SRAM
+#define SCHEDULER_MAX_TASKS 7
+
+/*
+  A task function, called by the scheduler when the task is ready
+  @return true if the task has more work to do and should stay ready
+*/
+typedef bool (*TaskFunction)();
+
+class Scheduler
+{
+  public:
+    // Constructor
+    Scheduler();
+    byte addTask(TaskFunction function, byte priority, const __FlashStringHelper *name);
+    void setReady(byte task);
+    bool isReady(byte task);
+    bool run();
+    unsigned long getMaxLatency(byte task);
+    unsigned long getMaxRunTime(byte task);
+    void printStats(HardwareSerial &port);
+    // Destructor
+    ~Scheduler();
+
+  private:
+    /*
+      function: the task function
+      priority: higher priority tasks are run first
+      ready: the task is waiting to be run
+      name: used when printing the stats
+      readyTime: micros() when the task was made ready
+      maxLatency: longest time in microseconds from being made ready to being run
+      maxRunTime: longest time in microseconds spent in a single call of the task function
+    */
+    struct Task {
+      TaskFunction function;
+      byte priority;
+      bool ready;
+      const __FlashStringHelper *name;
+      unsigned long readyTime;
+      unsigned long maxLatency;
+      unsigned long maxRunTime;
+    };
+    Task _tasks[SCHEDULER_MAX_TASKS];
+    byte _taskCount;
+};
+
+#endif
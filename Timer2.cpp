@@ -71,6 +71,7 @@ unsigned long Timer2::getCount()
   if (ovFlag) {
     tVal = TCNT2; // re-read Timer2 value just incase it had not overflowed on previous read
     _overflowCounter++; 
+    _jitterCount++; // this is the case which can delay the reading by a few us, count it for the stats
     // Reset the Timer2 overflow flag to prevent the execution of the Timer2 overflow ISR
     // TIFR2 bit zero is the TOV flag, it is cleared by writing a logic 1 to the flag.
     // All flags in TIFR2 are cleared by writing a 1.
@@ -85,6 +86,17 @@ unsigned long Timer2::getCount()
   return (_overflowCounter << 8) + tVal; // Use a left shift by 8 instead of multiplication by 256
 }
 
+/*
+  Gets the Timer2 counter value on its own, the low 8 bits of getCount()
+  Much quicker than getCount() as the overflow does not need to be handled, used to time short sections of
+  code such as the receiver ISR by subtracting the low 8 bits of an earlier getCount() (up to 128us).
+  It is not included in the jitter count as it can't be delayed by an overflow.
+*/
+uint8_t Timer2::getTicks()
+{
+  return TCNT2;
+}
+
 // Reset Timer2's counter TCNT2
 void Timer2::reset()
 {
@@ -27,6 +27,7 @@ class Timer2: public TimerBase
    
 	void configure(); 
 	unsigned long getCount();
+	uint8_t getTicks();
 	void reset();
 	void unconfigure();
 	~Timer2();
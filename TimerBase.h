@@ -17,17 +17,23 @@ class TimerBase
 {
   public:
   // Constructor
-  TimerBase::TimerBase() : _overflowCounter(0) {}
+  TimerBase() : _overflowCounter(0), _jitterCount(0) {}
 
 	virtual void configure() = 0;
 	virtual unsigned long getCount() = 0;
+	// The low 8 bits of the count read straight from the hardware, without handling overflows
+	// Only valid for timing sections of code shorter than 256 ticks
+	virtual uint8_t getTicks() = 0;
 	virtual void reset() = 0;
 	virtual void unconfigure() = 0;
     // This needs to be called by the Timer overflow ISR which has to be globally defined
 	virtual void incrementOverflowCounter();
+	// Number of reads which had to account for an overflow that occurred while being read (possible jitter)
+	unsigned int getJitterCount() { return _jitterCount; }
 	
   protected:
 	volatile unsigned long _overflowCounter;
+	volatile unsigned int _jitterCount;
 };
 
 // Note: inline functions must be included in the header file
@@ -0,0 +1,234 @@
+/*
+  File: TransmitQueue.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+*/
+#include "TransmitQueue.h"
+
+/*
+  Constructor
+  @airtimeBudget milliseconds of transmission allowed in each airtimeWindow, eg. 6000 in 60000 for a 10% duty cycle
+  @airtimeWindow length of the rolling window in milliseconds
+*/
+TransmitQueue::TransmitQueue(unsigned int airtimeBudget, unsigned long airtimeWindow) :
+            airtimeBudget(airtimeBudget),
+            airtimeWindow(airtimeWindow),
+            queuedCount(0),
+            coalescedCount(0),
+            dedupedCount(0),
+            droppedCount(0),
+            deferredCount(0),
+            airtimeTotal(0),
+            maxDepth(0),
+            lastLatency(0),
+            maxLatency(0),
+            _count(0),
+            _slot(0),
+            _slotStart(0),
+            _waitingAirtime(0)
+{
+  for (byte i = 0; i < TRANSMIT_AIRTIME_SLOTS; i++) _slots[i] = 0;
+}
+
+/*
+  Adds a command to the queue
+  If the same key is already pending it is not added again. If a command for the same device is pending
+  (eg. ENG10 and ENG11, the off and on keys of a socket) it is replaced by this one, keeping its place
+  in the queue, as only the final state needs to be sent. The merged command keeps the time the pending one
+  was queued, the device has been waiting since then.
+  @key the 5 character key of the pulse train
+  @device the device id from the pulse train's transmit profile, 0 if the command is never replaced
+  @now the current millis()
+  @return TX_QUEUED, TX_MERGED if it was merged with a pending command or TX_FULL if it was dropped
+*/
+TransmitQueueResult TransmitQueue::push(const char *key, byte device, unsigned long now)
+{
+  for (byte i = 0; i < _count; i++) {
+    if (strcmp(_keys[i], key) == 0) {
+      dedupedCount++;
+      return TX_MERGED;
+    }
+    if (device != 0 && _devices[i] == device) {
+      strcpy(_keys[i], key);
+      if (i == 0) _waitingAirtime = 0; // the new command may need a different amount of airtime
+      coalescedCount++;
+      return TX_MERGED;
+    }
+  }
+  if (_count == TRANSMIT_QUEUE_SIZE) {
+    droppedCount++;
+    return TX_FULL;
+  }
+  _devices[_count] = device;
+  _queuedTimes[_count] = now;
+  strcpy(_keys[_count++], key);
+  if (_count > maxDepth) maxDepth = _count;
+  queuedCount++;
+  return TX_QUEUED;
+}
+
+/*
+  @return the key of the command at the front of the queue, NULL if the queue is empty
+  The command stays in the queue until pop() is called so a later command for the same device can still replace it
+*/
+const char *TransmitQueue::peek()
+{
+  return _count > 0 ? _keys[0] : NULL;
+}
+
+/*
+  Removes the command at the front of the queue once it has been transmitted
+*/
+void TransmitQueue::pop()
+{
+  if (_count == 0) return;
+  _count--;
+  for (byte i = 0; i < _count; i++) {
+    strcpy(_keys[i], _keys[i + 1]);
+    _devices[i] = _devices[i + 1];
+    _queuedTimes[i] = _queuedTimes[i + 1];
+  }
+  _waitingAirtime = 0;
+}
+
+/*
+  @return the number of commands waiting to be transmitted
+*/
+byte TransmitQueue::getDepth()
+{
+  return _count;
+}
+
+/*
+  @now the current millis()
+  @return true if there is a command waiting and it is not being held back by the airtime budget
+*/
+bool TransmitQueue::isReady(unsigned long now)
+{
+  if (_count == 0) return false;
+  if (_waitingAirtime == 0) return true;
+  return getAirtimeUsed(now) + getRequiredAirtime(_waitingAirtime) <= airtimeBudget;
+}
+
+/*
+  Takes the airtime needed by the command at the front of the queue out of the budget
+  If there is not enough airtime left the command is held back, isReady() returns false until enough of the
+  airtime used earlier in the window has expired. A transmission longer than the whole budget is sent once none of it is in use.
+  @now the current millis()
+  @duration the estimated duration of the transmission in microseconds
+  @return true if the command can be transmitted now
+*/
+bool TransmitQueue::reserveAirtime(unsigned long now, unsigned long duration)
+{
+  if (!useAirtime(now, duration)) {
+    if (_waitingAirtime == 0) deferredCount++;
+    _waitingAirtime = getAirtime(duration);
+    return false;
+  }
+  _waitingAirtime = 0;
+  return true;
+}
+
+/*
+  Takes the airtime of a transmission out of the budget without involving the queue, used directly for
+  transmissions which are not queued (eg. the calibration pattern)
+  @now the current millis()
+  @duration the estimated duration of the transmission in microseconds
+  @return true if there was enough airtime left, false if there was not and none was taken
+*/
+bool TransmitQueue::useAirtime(unsigned long now, unsigned long duration)
+{
+  unsigned int airtime = getAirtime(duration);
+  if (getAirtimeUsed(now) + getRequiredAirtime(airtime) > airtimeBudget) return false;
+  _slots[_slot] += airtime;
+  airtimeTotal += airtime;
+  return true;
+}
+
+/*
+  Records how long the command at the front of the queue waited, called as its transmission starts
+  This covers the time spent in the queue behind other commands, waiting for a clear channel and held back by the airtime budget
+  @now the current millis()
+*/
+void TransmitQueue::recordLatency(unsigned long now)
+{
+  if (_count == 0) return;
+  lastLatency = now - _queuedTimes[0];
+  if (lastLatency > maxLatency) maxLatency = lastLatency;
+}
+
+/*
+  @now the current millis()
+  @return the milliseconds of airtime used in the rolling window
+*/
+unsigned int TransmitQueue::getAirtimeUsed(unsigned long now)
+{
+  advance(now);
+  unsigned int used = 0;
+  for (byte i = 0; i < TRANSMIT_AIRTIME_SLOTS; i++) used += _slots[i];
+  return used;
+}
+
+/*
+  Prints the queue depth, what happened to the commands, the airtime used and how long the commands waited to be sent
+  @port the serial port to use
+  @now the current millis()
+*/
+void TransmitQueue::printStats(HardwareSerial &port, unsigned long now)
+{
+  port.print(F("tx queue depth: ")); port.print(_count);
+  port.print(F(" max: ")); port.print(maxDepth);
+  port.print(F(" queued: ")); port.print(queuedCount);
+  port.print(F(" coalesced: ")); port.print(coalescedCount);
+  port.print(F(" deduped: ")); port.print(dedupedCount);
+  port.print(F(" dropped: ")); port.println(droppedCount);
+  port.print(F("tx airtime: ")); port.print(getAirtimeUsed(now));
+  port.print(F("ms of ")); port.print(airtimeBudget);
+  port.print(F("ms per ")); port.print(airtimeWindow / 1000);
+  port.print(F("s total: ")); port.print(airtimeTotal);
+  port.print(F("ms deferred: ")); port.println(deferredCount);
+  port.print(F("tx latency last: ")); port.print(lastLatency);
+  port.print(F("ms max: ")); port.print(maxLatency); port.println(F("ms"));
+}
+
+/*
+  Private: @return the airtime of a transmission in whole milliseconds, at least 1
+  @duration the estimated duration of the transmission in microseconds
+*/
+unsigned int TransmitQueue::getAirtime(unsigned long duration)
+{
+  unsigned int airtime = (duration + 999) / 1000;
+  return airtime > 0 ? airtime : 1;
+}
+
+/*
+  Private: @return the airtime that needs to be free in the budget to send a transmission, limited to the whole budget
+*/
+unsigned int TransmitQueue::getRequiredAirtime(unsigned int airtime)
+{
+  return airtime < airtimeBudget ? airtime : airtimeBudget;
+}
+
+/*
+  Private: Moves the window on to the current time, clearing the slots which have expired
+  Compared as elapsed times so it still works when millis() wraps around
+*/
+void TransmitQueue::advance(unsigned long now)
+{
+  unsigned long slotLength = airtimeWindow / TRANSMIT_AIRTIME_SLOTS;
+  if (now - _slotStart >= airtimeWindow) {
+    for (byte i = 0; i < TRANSMIT_AIRTIME_SLOTS; i++) _slots[i] = 0;
+    _slotStart = now;
+    return;
+  }
+  while (now - _slotStart >= slotLength) {
+    _slot = (_slot + 1) % TRANSMIT_AIRTIME_SLOTS;
+    _slots[_slot] = 0;
+    _slotStart += slotLength;
+  }
+}
+
+// Destructor
+TransmitQueue::~TransmitQueue() {
+  // nothing to destruct here
+}
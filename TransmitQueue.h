@@ -0,0 +1,76 @@
+/*
+  File: TransmitQueue.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Holds the commands waiting to be transmitted so that a burst of commands does not tie up the radio.
+  A command which supersedes a pending one for the same device (the device id of its transmit profile, refer to
+  TransmitProfile in ProgMemGlobals.h) takes its place so only the final state is sent,
+  a key which is already pending is not queued again and the time spent transmitting is limited to a
+  budget in each rolling window (duty cycle) so the receiver gets a chance to listen in between.
+
+  Refer to cpp file for function descriptions and more info
+*/
+#ifndef TransmitQueue_h
+#define TransmitQueue_h
+
+#include "Arduino.h"
+
+// Number of commands which can be waiting to be transmitted, each entry uses 11 bytes of SRAM
+#define TRANSMIT_QUEUE_SIZE 4
+// Number of slots the airtime window is divided into, the airtime used expires one slot at a time
+#define TRANSMIT_AIRTIME_SLOTS 6
+
+/*
+  The result of adding a command to the queue
+  TX_QUEUED: added to the end of the queue
+  TX_MERGED: replaced a pending command for the same device or the key was already pending
+  TX_FULL: dropped because the queue is full
+*/
+enum TransmitQueueResult { TX_QUEUED, TX_MERGED, TX_FULL };
+
+class TransmitQueue
+{
+  public:
+    // Constructor
+    TransmitQueue(unsigned int airtimeBudget, unsigned long airtimeWindow);
+    TransmitQueueResult push(const char *key, byte device, unsigned long now);
+    const char *peek();
+    void pop();
+    byte getDepth();
+    bool isReady(unsigned long now);
+    bool reserveAirtime(unsigned long now, unsigned long duration);
+    bool useAirtime(unsigned long now, unsigned long duration);
+    void recordLatency(unsigned long now);
+    unsigned int getAirtimeUsed(unsigned long now);
+    void printStats(HardwareSerial &port, unsigned long now);
+    unsigned int airtimeBudget; // milliseconds of transmission allowed in each airtimeWindow
+    unsigned long airtimeWindow; // milliseconds
+    // Performance counters, kept since boot
+    unsigned int queuedCount; // commands added to the end of the queue
+    unsigned int coalescedCount; // pending commands replaced by a later command for the same device
+    unsigned int dedupedCount; // commands not queued because the same key was already pending
+    unsigned int droppedCount; // commands dropped because the queue was full
+    unsigned int deferredCount; // transmissions held back until there was enough airtime left in the budget
+    unsigned long airtimeTotal; // milliseconds of airtime used since boot
+    byte maxDepth; // largest number of commands waiting since boot
+    unsigned long lastLatency; // milliseconds from the last transmitted command being queued to its transmission starting
+    unsigned long maxLatency; // longest lastLatency since boot
+    // Destructor
+    ~TransmitQueue();
+
+  private:
+    char _keys[TRANSMIT_QUEUE_SIZE][6];
+    byte _devices[TRANSMIT_QUEUE_SIZE]; // device id of each command, 0 if it is never replaced
+    unsigned long _queuedTimes[TRANSMIT_QUEUE_SIZE]; // millis() when each command was queued
+    byte _count;
+    unsigned int _slots[TRANSMIT_AIRTIME_SLOTS]; // milliseconds of airtime used in each slot of the window
+    byte _slot; // the slot currently being filled
+    unsigned long _slotStart; // millis() when the current slot started
+    unsigned int _waitingAirtime; // milliseconds of airtime needed by the command at the front of the queue, 0 if it is not waiting
+    unsigned int getAirtime(unsigned long duration);
+    unsigned int getRequiredAirtime(unsigned int airtime);
+    void advance(unsigned long now);
+};
+
+#endif
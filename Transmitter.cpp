@@ -4,6 +4,23 @@
   Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
 */
 #include "Transmitter.h"
+#include <EEPROM.h>
+
+// Marks the timing corrections as saved in the EEPROM, an erased EEPROM reads 0xFF
+#define CORRECTION_MAGIC 0xC5
+// Default timing correction, covers the execution time of the code around each delay
+#define DEFAULT_CORRECTION 12
+// Limits for the timing corrections, anything outside these is the result of a bad calibration
+#define MAX_CORRECTION 100
+// Longest delay delayMicroseconds is accurate for, longer delays are split up
+#define MAX_DELAY_MICROSECONDS 16383
+
+// The timing corrections as stored in the EEPROM
+struct StoredCorrection {
+  byte magic;
+  int16_t highCorrection;
+  int16_t lowCorrection;
+};
 
 /*
   Constructor
@@ -11,7 +28,9 @@
   @initialPulseDuration the duration of an initial high pulse sent by the transmitter
   used to allow a receivers automatic gain control to adjust ready for the pulses
 */
-Transmitter::Transmitter(int pin, int initialPulseDuration) : _startTime(0), _endTime(0) {
+Transmitter::Transmitter(int pin, int initialPulseDuration) : repeatCount(0), maxTotalDuration(0), sendCount(0),
+            _highCorrection(DEFAULT_CORRECTION), _lowCorrection(DEFAULT_CORRECTION), _isrCorrection(0),
+            _startTime(0), _endTime(0) {
   _pin = pin;
   _initialPulseDuration = initialPulseDuration;
   pinMode(_pin, OUTPUT);
@@ -25,9 +44,59 @@ Transmitter::Transmitter(int pin, int initialPulseDuration) : _startTime(0), _en
   the initial pulse only needs to be sent once
 */
 void Transmitter::send(std::vector<int16_t> *pulses, byte repeatCount) {
+  sendRepeats(pulses, repeatCount, _initialPulseDuration);
+}
+
+/*
+  Sends a pulse train using its transmit profile, any field of the profile which is 0 uses the default
+  @pulses the pulse train to be sent, the sync pulse (index 0) is replaced by the profile's repeat gap
+  so the receiver's echo is compared against what was actually sent
+  @profile the transmit profile of the pulse train from the library
+  @defaultRepeatCount number of times to repeat the pulse train if the profile does not set it
+*/
+void Transmitter::send(std::vector<int16_t> *pulses, const TransmitProfile &profile, byte defaultRepeatCount) {
+  if (profile.repeatGap != 0 && pulses->size() > 0 && (*pulses)[0] < 0) {
+    (*pulses)[0] = -abs(profile.repeatGap);
+  }
+  sendRepeats(pulses, profile.repeatCount != 0 ? profile.repeatCount : defaultRepeatCount, getPreamble(profile));
+}
+
+/*
+  Estimates how long send() will take, used to budget the airtime before transmitting
+  @pulses the pulse train to be sent
+  @profile the transmit profile of the pulse train from the library
+  @defaultRepeatCount number of times to repeat the pulse train if the profile does not set it
+  @return the duration of the preamble and all of the repeats in microseconds
+*/
+unsigned long Transmitter::estimateDuration(std::vector<int16_t> *pulses, const TransmitProfile &profile, byte defaultRepeatCount) {
+  unsigned long pulseTrainDuration = 0;
+  for (unsigned int i = 0; i < pulses->size(); i++) {
+    // the sync pulse is replaced by the repeat gap when sent
+    pulseTrainDuration += (i == 0 && profile.repeatGap != 0 && (*pulses)[0] < 0) ? abs(profile.repeatGap) : abs((*pulses)[i]);
+  }
+  byte repeats = profile.repeatCount != 0 ? profile.repeatCount : defaultRepeatCount;
+  return getPreamble(profile) + pulseTrainDuration * repeats;
+}
+
+/*
+  @profile the transmit profile of the pulse train from the library
+  @return the duration of the initial high pulse sent before the pulse train in microseconds
+*/
+int Transmitter::getPreamble(const TransmitProfile &profile) {
+  return profile.preamble != 0 ? profile.preamble : _initialPulseDuration;
+}
+
+/*
+  Private: Sends the preamble followed by the repeats of the pulse train and records how long it took
+  @pulses the pulse train to be sent
+  @repeatCount number of times to repeat the pulse train
+  @preamble the duration of the initial high pulse in microseconds
+*/
+void Transmitter::sendRepeats(std::vector<int16_t> *pulses, byte repeatCount, int preamble) {
   pulseCount = (*pulses).size();
+  this->repeatCount = repeatCount;
   digitalWrite(_pin, HIGH);
-  delayMicroseconds(_initialPulseDuration);
+  delayLong(preamble);
   _startTime = micros();  // On 16 MHz Arduino boards, micros has a precision of 4us
   for (unsigned int i = 0; i < repeatCount; i++) {
     sendPulseTrain(pulses);
@@ -36,6 +105,8 @@ void Transmitter::send(std::vector<int16_t> *pulses, byte repeatCount) {
   _endTime = micros();
   totalDuration = _endTime - _startTime;
   duration = totalDuration / repeatCount;
+  if (totalDuration > maxTotalDuration) maxTotalDuration = totalDuration;
+  sendCount++;
 }
 
 /*
@@ -49,10 +120,86 @@ void Transmitter::sendPulseTrain(std::vector<int16_t> *pulses) {
     digitalWrite(_pin, value);
     int pulseLength = abs(timing);
     // this is only ever accurate to 4us due to the accuracy of the micros() function
-    delayMicroseconds(pulseLength - 12); // subtract 10 uS to account for execution of the previous code
+    // the correction accounts for the execution of the previous code and the transmitter's rise / fall times
+    int pulseDelay = pulseLength - (value ? _highCorrection : _lowCorrection) - _isrCorrection;
+    if (pulseDelay > MAX_DELAY_MICROSECONDS) {
+      delayLong(pulseDelay); // a long repeat gap from the transmit profile
+    } else {
+      delayMicroseconds(pulseDelay > 0 ? pulseDelay : 0);
+    }
   }
 }
 
+/*
+  Private: Delays for longer than delayMicroseconds is accurate for by splitting the delay up
+  @us the delay in microseconds, nothing is done if it is 0 or negative
+*/
+void Transmitter::delayLong(long us) {
+  while (us > MAX_DELAY_MICROSECONDS) {
+    delayMicroseconds(MAX_DELAY_MICROSECONDS);
+    us -= MAX_DELAY_MICROSECONDS;
+  }
+  if (us > 0) delayMicroseconds(us);
+}
+
+/*
+  Sets the timing corrections, these are subtracted from the delay for each pulse
+  @highCorrection microseconds subtracted from the high pulses, clamped to +-MAX_CORRECTION
+  @lowCorrection microseconds subtracted from the low pulses, clamped to +-MAX_CORRECTION
+*/
+void Transmitter::setCorrection(int highCorrection, int lowCorrection) {
+  _highCorrection = constrain(highCorrection, -MAX_CORRECTION, MAX_CORRECTION);
+  _lowCorrection = constrain(lowCorrection, -MAX_CORRECTION, MAX_CORRECTION);
+}
+
+/*
+  Sets the time taken by the receiver's ISR to handle the echo of each pulse, it runs during the pulse's delay
+  and lengthens it, so it is subtracted from the delay for each pulse along with the timing corrections
+  @isrCorrection microseconds subtracted from every pulse, clamped to 0 - MAX_CORRECTION
+*/
+void Transmitter::setIsrCorrection(int isrCorrection) {
+  _isrCorrection = constrain(isrCorrection, 0, MAX_CORRECTION);
+}
+
+/*
+  @return microseconds subtracted from the delay for each high pulse
+*/
+int Transmitter::getHighCorrection() {
+  return _highCorrection;
+}
+
+/*
+  @return microseconds subtracted from the delay for each low pulse
+*/
+int Transmitter::getLowCorrection() {
+  return _lowCorrection;
+}
+
+/*
+  Loads the timing corrections saved by saveCorrection, the defaults are kept if none have been saved
+  @address the EEPROM address of the corrections (uses 5 bytes)
+  @return true if the corrections were loaded
+*/
+bool Transmitter::loadCorrection(int address) {
+  StoredCorrection stored;
+  EEPROM.get(address, stored);
+  if (stored.magic != CORRECTION_MAGIC) return false;
+  setCorrection(stored.highCorrection, stored.lowCorrection);
+  return true;
+}
+
+/*
+  Saves the timing corrections to the EEPROM so they are used after a restart
+  @address the EEPROM address of the corrections (uses 5 bytes)
+*/
+void Transmitter::saveCorrection(int address) {
+  StoredCorrection stored;
+  stored.magic = CORRECTION_MAGIC;
+  stored.highCorrection = _highCorrection;
+  stored.lowCorrection = _lowCorrection;
+  EEPROM.put(address, stored); // put only writes the bytes which have changed
+}
+
 // Destructor
 Transmitter::~Transmitter() {
   // nothing to destruct here
@@ -14,6 +14,7 @@
 #include "Arduino.h"
 #include <AvrSTL.h>
 #include <vector>
+#include "ProgMemGlobals.h"
 
 class Transmitter
 {
@@ -21,17 +22,34 @@ class Transmitter
     // Constructor
     Transmitter(int pin, int initialPulseDuration);
     unsigned int pulseCount; // length of pulse train that was last sent
+    byte repeatCount; // number of times the pulse train that was last sent was repeated
     unsigned long duration; // microseconds to send each pulse train 
     unsigned long totalDuration; // microseconds to send all pulse trains (duration * repeatCount)
+    unsigned long maxTotalDuration; // longest totalDuration since boot
+    unsigned int sendCount; // number of transmissions since boot
     void send(std::vector<int16_t> *pulses, byte repeatCount); // pulses is a pointer to a vector<int16_t> array
+    void send(std::vector<int16_t> *pulses, const TransmitProfile &profile, byte defaultRepeatCount);
+    unsigned long estimateDuration(std::vector<int16_t> *pulses, const TransmitProfile &profile, byte defaultRepeatCount);
+    int getPreamble(const TransmitProfile &profile);
+    void setCorrection(int highCorrection, int lowCorrection);
+    void setIsrCorrection(int isrCorrection);
+    int getHighCorrection();
+    int getLowCorrection();
+    bool loadCorrection(int address);
+    void saveCorrection(int address);
     ~Transmitter();
 
   private:
     int _pin;
     int _initialPulseDuration;
+    int _highCorrection; // microseconds subtracted from each high pulse delay
+    int _lowCorrection; // microseconds subtracted from each low pulse delay
+    int _isrCorrection; // microseconds subtracted from each pulse delay for the receiver's ISR which runs during the pulse
     unsigned long _startTime;
     unsigned long _endTime;
+    void sendRepeats(std::vector<int16_t> *pulses, byte repeatCount, int preamble);
     void sendPulseTrain(std::vector<int16_t> *pulses);
+    void delayLong(long us);
 };
 
 #endif
\ No newline at end of file
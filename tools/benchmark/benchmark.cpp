@@ -0,0 +1,441 @@
+/*
+  File: benchmark.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Synthetic signal benchmark for the capture and matching logic (host build)
+
+  Generates transmissions from the entries of a pulse train library, degrades them with
+  timing jitter, dropped and inserted edges, clock drift, partial leading repeats and AGC noise,
+  then feeds the edges through Receiver's capture logic (using a simulated timer in place of Timer2)
+  and matches the captured pulse trains using PulseTrainManager::findPulseTrain.
+  The stored pulse trains are also matched using the prefix trie layout (findPulseTrainTrie) for comparison,
+  the generated pulse trains are also matched as a bit-packed PWM library (PwmPulseTrainStruct), and both are
+  matched again with drift tolerant matching enabled (setDriftTolerant).
+
+  The library starts with the stored pulse trains from ProgMemGlobals.cpp and is padded with
+  randomly generated PWM pulse trains to sweep the library size up to 1000 entries.
+  Random pulse trains which are not in the library are also transmitted to measure false matches.
+  A fixed seed is used so the results can be compared between runs as a regression baseline.
+  Before the tests, each search is checked to complete without a match on an empty capture (exits with 1 if not).
+
+  Usage: benchmark [trials per test] [seed]
+*/
+#include "Arduino.h"
+#include "Receiver.h"
+#include "PulseTrainManager.h"
+#include "ProgMemGlobals.h"
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+using std::vector;
+
+/*
+  Replaces the hardware timer so that edges can be fed to the Receiver at chosen times
+  Counts in 0.5us ticks, the same as Timer2
+*/
+class SimulatedTimer : public TimerBase
+{
+  public:
+    SimulatedTimer() : TimerBase(), _count(1000) {}
+    void configure() {}
+    unsigned long getCount() { return _count; }
+    uint8_t getTicks() { return _count; }
+    void reset() { _count = 0; }
+    void unconfigure() {}
+    void advance(unsigned long microseconds) { _count += microseconds * 2; }
+
+  private:
+    unsigned long _count;
+};
+
+/*
+  Small xorshift random number generator, used instead of rand() so that
+  the generated signals are the same on every platform for a given seed
+*/
+class Random
+{
+  public:
+    Random(uint32_t seed) : _state(seed ? seed : 1) {}
+    uint32_t next() {
+      _state ^= _state << 13;
+      _state ^= _state >> 17;
+      _state ^= _state << 5;
+      return _state;
+    }
+    // returns a value between min and max inclusive
+    long range(long min, long max) { return min + (long)(next() % (uint32_t)(max - min + 1)); }
+    // returns true with a probability of perMille / 1000
+    bool chance(int perMille) { return perMille > 0 && (int)(next() % 1000) < perMille; }
+
+  private:
+    uint32_t _state;
+};
+
+/*
+  Describes how a transmission is degraded
+  jitter: maximum random error added to each pulse (microseconds)
+  drift: maximum clock drift applied to a whole transmission (per-mille, either direction)
+  dropPerMille: probability of an edge being missed by the receiver
+  insertPerMille: probability of a glitch (a pair of extra edges) being inserted into a pulse
+  partialRepeat: the capture starts part way through a repeat
+  agcNoise: noise from the receiver's automatic gain control before the transmission
+*/
+struct Profile {
+  const char *name;
+  int jitter;
+  int drift;
+  int dropPerMille;
+  int insertPerMille;
+  bool partialRepeat;
+  bool agcNoise;
+};
+
+static const Profile profiles[] = {
+  { "clean",       0,  0, 0, 0, false, false },
+  { "jitter",     15,  0, 0, 0, false, false },
+  { "drift",       0, 60, 0, 0, false, false },
+  { "rc drift",    0, 250, 0, 0, false, false },
+  { "drop/insert", 0,  0, 5, 5, false, false },
+  { "partial+agc", 0,  0, 0, 0, true,  true  },
+  { "all",        15, 60, 5, 5, true,  true  }
+};
+static const int profileCount = sizeof(profiles) / sizeof(Profile);
+static const int librarySizes[] = { 17, 50, 100, 250, 500, 1000 };
+static const int librarySizeCount = sizeof(librarySizes) / sizeof(int);
+static const int repeatCount = 5; // full repeats in each generated transmission
+static const int silenceDuration = 25000; // radio silence after the transmission (microseconds)
+
+/*
+  Turns a sequence of pulses into edges fed into the Receiver
+  An edge is only generated when the level changes, consecutive pulses with the same level are merged
+*/
+class SignalGenerator
+{
+  public:
+    SignalGenerator(Receiver &receiver, SimulatedTimer &timer, Random &random, const Profile &profile) :
+      edgeCount(0), _receiver(receiver), _timer(timer), _random(random), _profile(profile),
+      _level(false), _pending(0), _drift(0) {}
+
+    unsigned long edgeCount;
+
+    // Generates a transmission of a pulse train including any noise and repeats required by the profile
+    void transmit(const int16_t *pulseTrain, int size) {
+      _drift = _profile.drift ? _random.range(-_profile.drift, _profile.drift) : 0;
+      if (_profile.agcNoise) noise(20000);
+      if (_profile.partialRepeat) {
+        for (int i = _random.range(size / 4, (size * 3) / 4); i < size; i++) pulse(pulseTrain[i]);
+      }
+      for (int r = 0; r < repeatCount; r++) {
+        for (int i = 0; i < size; i++) pulse(pulseTrain[i]);
+      }
+      finish();
+    }
+
+    // Generates noise as received while the receiver's gain is ramped up (no transmission)
+    void noise(unsigned long duration) {
+      unsigned long elapsed = 0;
+      while (elapsed < duration) {
+        int length = _random.range(20, 600);
+        level(!_level, length);
+        elapsed += length;
+      }
+    }
+
+    // Ends the transmission with radio silence followed by noise so the silence is terminated by an edge
+    void finish() {
+      level(false, silenceDuration);
+      level(true, _random.range(20, 600));
+      level(false, 1);
+    }
+
+  private:
+    Receiver &_receiver;
+    SimulatedTimer &_timer;
+    Random &_random;
+    const Profile &_profile;
+    bool _level;
+    unsigned long _pending; // duration of the current level so far
+    int _drift;
+
+    // Adds a pulse from a pulse train, applying the profile's drift, jitter and glitches
+    void pulse(int16_t value) {
+      bool high = value > 0;
+      long length = abs(value);
+      length += (length * _drift) / 1000;
+      if (_profile.jitter) length += _random.range(-_profile.jitter, _profile.jitter);
+      if (length < 10) length = 10;
+      if (_random.chance(_profile.insertPerMille) && length > 100) {
+        long glitch = _random.range(10, 40);
+        long first = _random.range(10, length - glitch - 10);
+        level(high, first);
+        level(!high, glitch);
+        level(high, length - first - glitch);
+      } else {
+        level(high, length);
+      }
+    }
+
+    // Sets the signal level for a duration, generating an edge if the level changes
+    void level(bool high, unsigned long duration) {
+      if (high != _level && _pending > 0) {
+        if (!_random.chance(_profile.dropPerMille)) {
+          _timer.advance(_pending);
+          _receiver.injectStateChange(high); // a rising edge ends a low pulse
+          edgeCount++;
+          _pending = 0;
+        }
+      }
+      _level = high;
+      _pending += duration;
+    }
+};
+
+/*
+  Generates a random two symbol PWM pulse train with a sync gap, similar to most cheap remotes
+  @pulseTrain out parameter, filled with the pulses
+*/
+static void generatePwmTrain(Random &random, vector<int16_t> &pulseTrain) {
+  int shortPulse = random.range(180, 500);
+  int longPulse = shortPulse * random.range(25, 35) / 10;
+  int bits = random.range(20, 32);
+  pulseTrain.clear();
+  pulseTrain.push_back(-random.range(5500, 14000));
+  for (int i = 0; i < bits; i++) {
+    if (random.next() & 1) {
+      pulseTrain.push_back(longPulse);
+      pulseTrain.push_back(-shortPulse);
+    } else {
+      pulseTrain.push_back(shortPulse);
+      pulseTrain.push_back(-longPulse);
+    }
+  }
+  pulseTrain.push_back(shortPulse);
+}
+
+// Results of a single library size / profile test
+struct Result {
+  int trials;
+  int correct;
+  int wrong;
+  int missed; // not captured or not matched
+  int unknownTrials;
+  int falseMatches; // unknown pulse trains which were matched to a key
+  int searches; // captures which were passed to findPulseTrain
+  unsigned long edges;
+  double captureSeconds;
+  double matchSeconds;
+  double maxMatchSeconds;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// How the library is stored and searched
+enum MatchMode { RAW, TRIE, PWM, DRIFT };
+static const char *modeNames[] = { "raw", "trie", "pwm", "drift" };
+
+/*
+  Transmits a pulse train through the receiver and matches the capture
+  @return true if a pulse train was captured and matched, the key is returned in match
+*/
+static bool captureAndMatch(Receiver &receiver, SimulatedTimer &timer, PulseTrainManager &manager, Random &random,
+                            const Profile &profile, const vector<int16_t> &pulseTrain, Result &result, MatchResult &match,
+                            MatchMode mode) {
+  SignalGenerator generator(receiver, timer, random, profile);
+  receiver.startScanning();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  generator.transmit(&pulseTrain[0], pulseTrain.size());
+  result.captureSeconds += secondsSince(start);
+  result.edges += generator.edgeCount;
+  if (receiver.available(0, 0) == 0) {
+    receiver.stopScanning();
+    return false;
+  }
+  vector<int16_t> detectedPulseTrain;
+  receiver.getPulseTrain(&detectedPulseTrain);
+  result.searches++;
+  start = std::chrono::steady_clock::now();
+  bool found = mode == TRIE ? manager.findPulseTrainTrie(&detectedPulseTrain, &match)
+                     : manager.findPulseTrain(&detectedPulseTrain, &match);
+  double seconds = secondsSince(start);
+  result.matchSeconds += seconds;
+  if (seconds > result.maxMatchSeconds) result.maxMatchSeconds = seconds;
+  return found;
+}
+
+/*
+  Transmits pulse trains chosen at random from the library followed by unknown pulse trains
+  @library the raw form of every pulse train, used for transmitting
+  @pwmLibrary the bit-packed form of the generated pulse trains which follow the stored ones in the library
+  @mode how the library is stored and searched
+*/
+static Result runTest(const vector<PulseTrainStruct> &library, const vector<PwmPulseTrainStruct> &pwmLibrary,
+                      const Profile &profile, int trials, uint32_t seed, MatchMode mode) {
+  Result result = Result();
+  Random random(seed);
+  SimulatedTimer timer;
+  Receiver receiver(&timer, 2, 3, LED_BUILTIN);
+  receiver.configure();
+  // the trie layout only exists for the stored library, so that test uses the default constructor
+  PulseTrainManager *manager;
+  if (mode == TRIE) {
+    manager = new PulseTrainManager();
+  } else if (mode == PWM || mode == DRIFT) {
+    int rawSize = library.size() - pwmLibrary.size();
+    manager = new PulseTrainManager(&library[0], rawSize, pwmLibrary.empty() ? NULL : &pwmLibrary[0], pwmLibrary.size());
+    if (mode == DRIFT) manager->setDriftTolerant(true);
+  } else {
+    manager = new PulseTrainManager(&library[0], library.size());
+  }
+  vector<int16_t> pulseTrain;
+  MatchResult match;
+  for (int t = 0; t < trials; t++) {
+    const PulseTrainStruct &item = library[random.range(0, library.size() - 1)];
+    pulseTrain.assign(item.pulseTrain, item.pulseTrain + item.pulseTrainSize);
+    result.trials++;
+    if (!captureAndMatch(receiver, timer, *manager, random, profile, pulseTrain, result, match, mode)) {
+      result.missed++;
+    } else if (strcmp(match.key, item.key) == 0) {
+      result.correct++;
+    } else {
+      result.wrong++;
+    }
+  }
+  // pulse trains which are not in the library should never be matched
+  for (int t = 0; t < trials / 4; t++) {
+    generatePwmTrain(random, pulseTrain);
+    result.unknownTrials++;
+    if (captureAndMatch(receiver, timer, *manager, random, profile, pulseTrain, result, match, mode)) {
+      result.falseMatches++;
+    }
+  }
+  delete manager;
+  return result;
+}
+
+/*
+  Packs a generated PWM pulse train into a PwmPulseTrainStruct
+  @pulseTrain a pulse train made by generatePwmTrain
+  @key the key to use (5 characters and the nul terminator)
+  @bits out parameter, storage for the packed bits which item points to
+  @item out parameter, the bit-packed pulse train
+*/
+static void packPwmTrain(const vector<int16_t> &pulseTrain, const char *key, vector<uint8_t> &bits,
+                         PwmPulseTrainStruct &item) {
+  memset(&item, 0, sizeof item);
+  memcpy(item.key, key, sizeof item.key);
+  item.syncGap = pulseTrain[0];
+  item.shortPulse = pulseTrain.back();
+  item.bitCount = (pulseTrain.size() - 2) / 2;
+  bits.assign((item.bitCount + 7) / 8, 0);
+  item.bits = &bits[0];
+  for (int b = 0; b < item.bitCount; b++) {
+    int16_t high = pulseTrain[1 + b * 2];
+    if (high > item.shortPulse) {
+      item.longPulse = high;
+      bits[b / 8] |= 0x80 >> (b % 8);
+    } else {
+      item.longPulse = -pulseTrain[2 + b * 2];
+    }
+  }
+}
+
+/*
+  Regression check: an empty capture must complete the search straight away without a match
+  The time sliced search is continued a bounded number of times so a search which never completes fails rather than hangs
+  @return true if every mode handled the empty capture
+*/
+static bool checkEmptyCapture(const vector<PulseTrainStruct> &library, const vector<PwmPulseTrainStruct> &pwmLibrary) {
+  bool passed = true;
+  vector<int16_t> empty;
+  MatchResult match;
+  PulseTrainManager trieManager;
+  if (trieManager.findPulseTrainTrie(&empty, &match)) {
+    printf("empty capture: trie search found a match\n");
+    passed = false;
+  }
+  int rawSize = library.size() - pwmLibrary.size();
+  for (int m = RAW; m <= DRIFT; m++) {
+    if (m == TRIE) continue;
+    PulseTrainManager manager(&library[0], m == RAW ? library.size() : rawSize,
+                              m == RAW || pwmLibrary.empty() ? NULL : &pwmLibrary[0], m == RAW ? 0 : pwmLibrary.size());
+    manager.setDriftTolerant(m == DRIFT);
+    manager.beginMatch(&empty);
+    int slices = 0;
+    while (!manager.continueMatch(1) && slices < 1000000) slices++;
+    if (!manager.isMatchComplete()) {
+      printf("empty capture: %s search did not complete\n", modeNames[m]);
+      passed = false;
+    } else if (manager.getMatchResult(&match)) {
+      printf("empty capture: %s search found a match\n", modeNames[m]);
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+static double percent(int count, int total) {
+  return total ? (100.0 * count) / total : 0.0;
+}
+
+static void printResult(int size, MatchMode mode, const char *profileName, const Result &r) {
+  printf("%-7d %-5s %-12s %8.1f %8.1f %8.1f %8.1f %10.1f %10.1f %12.0f %12.0f\n",
+         size, modeNames[mode], profileName,
+         percent(r.correct, r.trials), percent(r.wrong, r.trials), percent(r.missed, r.trials),
+         percent(r.falseMatches, r.unknownTrials),
+         r.searches > 0 ? (r.matchSeconds * 1e6) / r.searches : 0.0, r.maxMatchSeconds * 1e6,
+         r.matchSeconds > 0 ? r.searches / r.matchSeconds : 0.0,
+         r.captureSeconds > 0 ? r.edges / r.captureSeconds : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+  int trials = argc > 1 ? atoi(argv[1]) : 200;
+  uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 2018;
+
+  // The stored pulse trains followed by generated ones to make up the largest library size
+  vector<PulseTrainStruct> library;
+  vector<vector<int16_t> > storage(librarySizes[librarySizeCount - 1]);
+  for (int i = 0; i < pulseTrainArraySize; i++) {
+    PulseTrainStruct item;
+    memcpy_P(&item, &pulseTrainArray[i], sizeof item);
+    library.push_back(item);
+  }
+  // the generated pulse trains are also packed into a PWM library
+  vector<PwmPulseTrainStruct> pwmLibrary;
+  vector<vector<uint8_t> > pwmBits(librarySizes[librarySizeCount - 1]);
+  Random libraryRandom(seed ^ 0x5A5A5A5A);
+  for (int i = library.size(); i < librarySizes[librarySizeCount - 1]; i++) {
+    generatePwmTrain(libraryRandom, storage[i]);
+    PulseTrainStruct item = PulseTrainStruct();
+    snprintf(item.key, sizeof item.key, "S%03d", i % 1000);
+    item.pulseTrainSize = storage[i].size();
+    item.pulseTrain = &storage[i][0];
+    library.push_back(item);
+    PwmPulseTrainStruct pwmItem;
+    packPwmTrain(storage[i], item.key, pwmBits[i], pwmItem);
+    pwmLibrary.push_back(pwmItem);
+  }
+
+  if (!checkEmptyCapture(library, pwmLibrary)) return 1;
+
+  printf("Synthetic signal benchmark: %d trials per test (+%d unknown), seed %u\n", trials, trials / 4, (unsigned)seed);
+  printf("%-7s %-5s %-12s %8s %8s %8s %8s %10s %10s %12s %12s\n",
+         "library", "mode", "profile", "correct%", "wrong%", "missed%", "falseM%",
+         "avgMatchUs", "maxMatchUs", "matches/s", "edges/s");
+  for (int s = 0; s < librarySizeCount; s++) {
+    int size = librarySizes[s] < pulseTrainArraySize ? pulseTrainArraySize : librarySizes[s];
+    vector<PulseTrainStruct> subset(library.begin(), library.begin() + size);
+    vector<PwmPulseTrainStruct> pwmSubset(pwmLibrary.begin(), pwmLibrary.begin() + (size - pulseTrainArraySize));
+    for (int m = RAW; m <= DRIFT; m++) {
+      // the trie layout only covers the stored pulse trains
+      if (m == TRIE && size != pulseTrainArraySize) continue;
+      for (int p = 0; p < profileCount; p++) {
+        MatchMode mode = (MatchMode)m;
+        printResult(size, mode, profiles[p].name, runTest(subset, pwmSubset, profiles[p], trials, seed + p, mode));
+      }
+    }
+  }
+  return 0;
+}
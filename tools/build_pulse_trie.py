@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+"""
+  File: build_pulse_trie.py
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Builds the prefix trie layout of the pulse train library (ProgMemTrie.cpp) from ProgMemGlobals.cpp
+  Run this after adding or changing pulse trains in ProgMemGlobals.cpp:
+    python3 tools/build_pulse_trie.py
+  A checksum of the pulse trains is stored with the trie, the firmware does not use the trie if it does not match.
+
+  The pulses are first quantized: pulses of the same polarity within about 5% of each other across
+  the whole library are replaced by a single canonical value, so pulse trains from the same family of
+  devices share the same values where they were captured with slightly different timings.
+  The quantized pulse trains (excluding the sync gap at index 0, which is not compared when matching)
+  are inserted into a trie, chains of nodes with a single child are merged into one node with a run of
+  pulses, and shared runs are stored once in the pulse pool.
+  Nodes are laid out breadth first so the children of each node are contiguous.
+"""
+import os
+import re
+import sys
+
+SKETCH_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+SOURCE = os.path.join(SKETCH_DIR, 'ProgMemGlobals.cpp')
+OUTPUT = os.path.join(SKETCH_DIR, 'ProgMemTrie.cpp')
+HEADER = os.path.join(SKETCH_DIR, 'ProgMemGlobals.h')
+CLUSTER_SPAN = 1.10  # the largest pulse in a cluster is at most 10% longer than the smallest (about +-5% of the centre)
+NODE_SIZE = 8  # sizeof(PulseTrieNode) on the AVR
+
+
+def strip_comments(source):
+    source = re.sub(r'/\*.*?\*/', '', source, flags=re.S)
+    return re.sub(r'//[^\n]*', '', source)
+
+
+def parse_library(path):
+    """Returns a list of (key, pulses) in the order of pulseTrainArray"""
+    source = strip_comments(open(path).read())
+    arrays = {}
+    for match in re.finditer(r'const\s+int16_t\s+(\w+)\s*\[\s*\]\s*PROGMEM\s*=\s*\{([^}]*)\}', source):
+        arrays[match.group(1)] = [int(value) for value in match.group(2).split(',') if value.strip()]
+    table = re.search(r'pulseTrainArray\s*\[\s*\]\s*PROGMEM\s*=\s*\{(.*?)\};', source, re.S)
+    if not table:
+        sys.exit('pulseTrainArray not found in ' + path)
+    library = []
+    for match in re.finditer(r'\{\s*"(\w+)"\s*,[^,]*,\s*\(int16_t\s*\*\)\s*&?(\w+)', table.group(1)):
+        key, name = match.group(1), match.group(2)
+        if name not in arrays:
+            sys.exit('pulse train %s used by %s not found' % (name, key))
+        library.append((key, arrays[name]))
+    return library
+
+
+def library_checksum(library):
+    """Checksum of the sizes and pulses of the pulse trains, must match PulseTrainManager::getLibraryChecksum"""
+    checksum = 0
+    for _, pulses in library:
+        for value in [len(pulses)] + pulses:
+            checksum = (checksum * 31 + (value & 0xFFFF)) & 0xFFFF
+    return checksum
+
+
+def quantize(library):
+    """Returns a dict mapping each pulse value to its canonical value"""
+    canonical = {}
+    for sign in (1, -1):
+        values = sorted(set(abs(v) for _, pulses in library for v in pulses[1:] if (v > 0) == (sign > 0)))
+        cluster = []
+        for value in values + [None]:
+            if value is not None and (not cluster or value <= cluster[0] * CLUSTER_SPAN):
+                cluster.append(value)
+                continue
+            centre = int(round(sum(cluster) / float(len(cluster))))
+            for member in cluster:
+                canonical[sign * member] = sign * centre
+            cluster = [value]
+    return canonical
+
+
+class Node(object):
+    def __init__(self):
+        self.run = []
+        self.children = []
+        self.entries = []
+
+
+def build_trie(sequences):
+    root = Node()
+    for index, sequence in enumerate(sequences):
+        node = root
+        for pulse in sequence:
+            child = next((c for c in node.children if c.run[0] == pulse), None)
+            if child is None:
+                child = Node()
+                child.run = [pulse]
+                node.children.append(child)
+            node = child
+        node.entries.append(index)
+    compress(root)
+    return root
+
+
+def compress(node):
+    """Merges chains of single children into runs and splits nodes that end more than one entry"""
+    for child in node.children:
+        while len(child.children) == 1 and not child.entries:
+            only = child.children[0]
+            child.run += only.run
+            child.children = only.children
+            child.entries = only.entries
+        compress(child)
+    if len(node.entries) > 1:
+        # identical quantized pulse trains, each extra entry gets its own empty child node
+        for entry in node.entries[1:]:
+            extra = Node()
+            extra.entries = [entry]
+            node.children.append(extra)
+        node.entries = node.entries[:1]
+
+
+def trie_depth(node):
+    """Returns the number of levels of nodes below node"""
+    return max([trie_depth(child) + 1 for child in node.children] or [0])
+
+
+def max_depth(path):
+    """Returns PULSE_TRIE_MAX_DEPTH from ProgMemGlobals.h, the deepest trie PulseTrainManager::searchTrie can walk"""
+    match = re.search(r'#define\s+PULSE_TRIE_MAX_DEPTH\s+(\d+)', open(path).read())
+    if not match:
+        sys.exit('PULSE_TRIE_MAX_DEPTH not found in ' + path)
+    return int(match.group(1))
+
+
+def layout(root):
+    """Breadth first layout, returns the list of nodes with the children of each node contiguous"""
+    nodes = [root]
+    i = 0
+    while i < len(nodes):
+        nodes.extend(nodes[i].children)
+        i += 1
+    return nodes
+
+
+def pool_runs(nodes):
+    """Stores each distinct run once, runs which are the tail of a longer run reuse it"""
+    pool = []
+    starts = {}
+    for node in sorted(nodes, key=lambda n: -len(n.run)):
+        run = tuple(node.run)
+        if not run or run in starts:
+            continue
+        for offset in range(len(pool) - len(run) + 1):
+            if tuple(pool[offset:offset + len(run)]) == run:
+                starts[run] = offset
+                break
+        else:
+            starts[run] = len(pool)
+            pool.extend(run)
+    return pool, starts
+
+
+def main():
+    library = parse_library(SOURCE)
+    if len(library) > 32767:
+        sys.exit('too many pulse trains')
+    canonical = quantize(library)
+    sequences = [[canonical[v] for v in pulses[1:]] for _, pulses in library]
+    root = build_trie(sequences)
+    depth = trie_depth(root)
+    if depth > max_depth(HEADER):
+        sys.exit('trie is %d levels deep, increase PULSE_TRIE_MAX_DEPTH in ProgMemGlobals.h' % depth)
+    nodes = layout(root)
+    pool, starts = pool_runs(nodes)
+    index = {id(node): i for i, node in enumerate(nodes)}
+    for node in nodes:
+        if len(node.run) > 255 or len(node.children) > 255:
+            sys.exit('node too large for PulseTrieNode')
+
+    raw_bytes = sum(len(pulses) * 2 for _, pulses in library)
+    trie_bytes = len(pool) * 2 + len(nodes) * NODE_SIZE
+    lines = []
+    lines.append('/*')
+    lines.append('   File: ProgMemTrie.cpp')
+    lines.append('   Generated by tools/build_pulse_trie.py from ProgMemGlobals.cpp, do not edit by hand.')
+    lines.append('')
+    lines.append('   Prefix trie layout of the pulse trains in pulseTrainArray, stored in Flash (PROGMEM).')
+    lines.append('   Used by PulseTrainManager::findPulseTrainTrie to match against all of the pulse trains in one traversal.')
+    lines.append('   %d pulse trains, %d nodes (%d levels deep), %d pooled pulses: %d bytes (the raw pulse trains use %d bytes)'
+                 % (len(library), len(nodes), depth, len(pool), trie_bytes, raw_bytes))
+    lines.append('*/')
+    lines.append('')
+    lines.append('#include "ProgMemGlobals.h"')
+    lines.append('')
+    lines.append('static_assert(%d <= PULSE_TRIE_MAX_DEPTH, "pulse trie too deep for PulseTrainManager::searchTrie, '
+                 'increase PULSE_TRIE_MAX_DEPTH");' % depth)
+    lines.append('')
+    lines.append('const int16_t pulseTriePulses[] PROGMEM = {')
+    for offset in range(0, len(pool), 16):
+        lines.append('  ' + ','.join(str(v) for v in pool[offset:offset + 16]) + ',')
+    lines.append('};')
+    lines.append('')
+    lines.append('// { pulseStart, pulseCount, childCount, firstChild, entry }')
+    lines.append('const PulseTrieNode pulseTrieNodes[] PROGMEM = {')
+    for node in nodes:
+        first_child = index[id(node.children[0])] if node.children else 0
+        entry = node.entries[0] if node.entries else -1
+        comment = '  // ' + library[entry][0] if entry >= 0 else ''
+        lines.append('  { %d, %d, %d, %d, %d },%s' % (starts.get(tuple(node.run), 0), len(node.run),
+                                                    len(node.children), first_child, entry, comment))
+    lines.append('};')
+    lines.append('const int pulseTrieNodeCount = %d;' % len(nodes))
+    lines.append('const int pulseTrieEntryCount = %d; // must equal pulseTrainArraySize' % len(library))
+    lines.append('const uint16_t pulseTrieChecksum = 0x%04X; // checksum of the pulse trains in pulseTrainArray'
+                 % library_checksum(library))
+    lines.append('')
+    with open(OUTPUT, 'w') as output:
+        output.write('\n'.join(lines))
+    print('%d pulse trains, %d nodes (%d levels deep), %d pooled pulses: trie %d bytes, raw pulse trains %d bytes'
+          % (len(library), len(nodes), depth, len(pool), trie_bytes, raw_bytes))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""
+  File: build_pwm_library.py
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Lists the pulse trains in ProgMemGlobals.cpp which fit the two symbol PWM model and prints the
+  bit-packed PwmPulseTrainStruct entries for them along with their bits, to be pasted into
+  ProgMemGlobals.cpp in place of the empty PWM library and the raw pulse trains:
+    python3 tools/build_pwm_library.py
+
+  A pulse train fits if after the sync gap it is made up of pairs of a high and a low pulse, where one
+  pulse of each pair is at least 1.5 times longer than the other, followed by a final short high pulse,
+  and all of the short pulses and all of the long pulses are within about 5% of their averages.
+  The bit-packed entry is rebuilt using the average short and long pulses when it is transmitted.
+"""
+import sys
+
+from build_pulse_trie import SOURCE, parse_library
+
+MAX_BITS = 64
+SPREAD = 0.05  # maximum difference of a pulse from the average of the short or long pulses
+
+
+def pack(pulses):
+    """Returns (shortPulse, longPulse, bits) or the reason the pulse train does not fit"""
+    symbols = pulses[1:]
+    if len(symbols) < 3 or len(symbols) % 2 == 0:
+        return 'not a sync gap followed by pairs of pulses and a final high pulse'
+    if (len(symbols) - 1) // 2 > MAX_BITS:
+        return 'more than %d bits' % MAX_BITS
+    bits = []
+    short_pulses = [symbols[-1]]
+    long_pulses = []
+    for high, low in zip(symbols[0:-1:2], symbols[1:-1:2]):
+        low = -low
+        if high <= 0 or low <= 0:
+            return 'pulses are not alternating high and low'
+        if high * 2 >= low * 3:
+            bits.append(1)
+            long_pulses.append(high)
+            short_pulses.append(low)
+        elif low * 2 >= high * 3:
+            bits.append(0)
+            long_pulses.append(low)
+            short_pulses.append(high)
+        else:
+            return 'pair %d, %d is not a short and a long pulse' % (high, -low)
+    short_pulse = int(round(sum(short_pulses) / float(len(short_pulses))))
+    long_pulse = int(round(sum(long_pulses) / float(len(long_pulses)))) if long_pulses else short_pulse * 3
+    for pulse, average in [(p, short_pulse) for p in short_pulses] + [(p, long_pulse) for p in long_pulses]:
+        if abs(pulse - average) > average * SPREAD:
+            return 'pulse %d is too far from the average %d' % (pulse, average)
+    return short_pulse, long_pulse, bits
+
+
+def main():
+    library = parse_library(SOURCE)
+    entries = []
+    for key, pulses in library:
+        result = pack(pulses)
+        if isinstance(result, str):
+            print('// %s does not fit: %s' % (key, result), file=sys.stderr)
+            continue
+        short_pulse, long_pulse, bits = result
+        # only the bytes holding bits are stored
+        packed = [0] * ((len(bits) + 7) // 8)
+        for i, bit in enumerate(bits):
+            packed[i // 8] |= bit << (7 - i % 8)
+        name = 'pwm_' + key.lower()
+        print('const uint8_t %s[] PROGMEM = { %s };' % (name, ','.join('0x%02X' % b for b in packed)))
+        entries.append('  { "%s", %d, %d, %d, %d, %s }' % (key, pulses[0], short_pulse, long_pulse, len(bits), name))
+    if entries:
+        print('const PwmPulseTrainStruct pwmPulseTrains[] PROGMEM = {')
+        print(',\n'.join(entries))
+        print('};')
+        print('const PwmPulseTrainStruct *pwmPulseTrainArray = pwmPulseTrains;')
+        print('int pwmPulseTrainArraySize = (sizeof pwmPulseTrains) / sizeof(PwmPulseTrainStruct);')
+    print('// %d of %d pulse trains fit the PWM model' % (len(entries), len(library)), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
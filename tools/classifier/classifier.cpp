@@ -0,0 +1,434 @@
+/*
+  File: classifier.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Classifies the pulse trains in capture log files using the firmware's PulseTrainManager (host build)
+
+  Capture log format, one captured pulse train per line:
+    [timestamp<space or tab>]pulse,pulse,pulse,...
+  The pulses are the captured pulse train as returned by Receiver::getPulseTrain, a line of pulses from the
+  debug output can also be used (it stops at the first 0), only the last SAMPLESIZE pulses are used as on the firmware.
+  Blank lines and lines starting with # are ignored.
+
+  The log files are memory mapped and split into chunks which are classified in parallel, each thread has
+  its own PulseTrainManager so the match decisions are exactly the same as the firmware's (findPulseTrain,
+  or findPulseTrainTrie with -t to match a firmware built with PULSE_TRIE).
+
+  Writes a log of the matches to stdout, one line per captured pulse train:
+    timestamp<tab>key<tab>confidence<tab>margin
+  Pulse trains which don't match are logged with a key of ?Cn and grouped into clusters by their last repeat
+  (the pulses after the last sync gap, rounded), the clusters are summarised on stderr along with an example of each.
+  When there is no timestamp the line number is used instead.
+
+  Usage: classifier [-l ProgMemGlobals.cpp] [-j threads] [-t] [-d] [-c clusters] log files...
+    -l  the library of pulse trains, a file in the same format as ProgMemGlobals.cpp (defaults to the built in library)
+    -j  number of threads (defaults to the number of cores)
+    -t  match using the prefix trie layout (built in library only)
+    -d  drift tolerant matching, to match a firmware built with DRIFT_TOLERANT
+    -c  number of unknown clusters to summarise (defaults to 20)
+*/
+#include "Arduino.h"
+#include "PulseTrainManager.h"
+#include "ProgMemGlobals.h"
+#include "Receiver.h"
+#include "Macros.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using std::string;
+using std::vector;
+
+/*
+  A library loaded from a file in the same format as ProgMemGlobals.cpp
+  The pulse trains are kept in RAM, the host build's progmem functions read RAM
+*/
+struct Library {
+  vector<PulseTrainStruct> pulseTrains;
+  vector<PwmPulseTrainStruct> pwmPulseTrains;
+  vector<vector<int16_t> > storage;
+  vector<vector<uint8_t> > pwmStorage;
+};
+
+// Parses a comma separated list of numbers
+static vector<long> parseNumbers(const string &text) {
+  vector<long> numbers;
+  std::stringstream stream(text);
+  string item;
+  while (std::getline(stream, item, ',')) {
+    if (item.find_first_not_of(" \t\r\n") != string::npos) numbers.push_back(strtol(item.c_str(), NULL, 0));
+  }
+  return numbers;
+}
+
+// Removes the comments so that commented out pulse trains are not loaded
+static string stripComments(const string &text) {
+  string source;
+  source.reserve(text.size());
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text.compare(i, 2, "/*") == 0) {
+      size_t end = text.find("*/", i + 2);
+      if (end == string::npos) break;
+      i = end + 1;
+    } else if (text.compare(i, 2, "//") == 0) {
+      size_t end = text.find('\n', i);
+      if (end == string::npos) break;
+      i = end - 1;
+    } else if (text[i] == '"') {
+      // strings are copied as they are, the keys don't contain quotes
+      size_t end = text.find('"', i + 1);
+      if (end == string::npos) end = text.size() - 1;
+      source.append(text, i, end - i + 1);
+      i = end;
+    } else {
+      source += text[i];
+    }
+  }
+  return source;
+}
+
+// Returns the contents of the table which is initialised after name, empty if not found
+static string findTable(const string &source, const string &name) {
+  std::smatch match;
+  if (!std::regex_search(source, match, std::regex(name + "\\s*\\[\\s*\\]\\s*PROGMEM\\s*=\\s*\\{([^;]*)\\};"))) return "";
+  return match[1];
+}
+
+/*
+  Loads the pulse trains from a file in the same format as ProgMemGlobals.cpp
+  @return false if the file could not be read or contains no pulse trains
+*/
+static bool loadLibrary(const char *path, Library &library) {
+  std::ifstream file(path);
+  if (!file) return false;
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  string source = stripComments(buffer.str());
+
+  std::map<string, vector<int16_t> > arrays;
+  std::regex arrayPattern("const\\s+int16_t\\s+(\\w+)\\s*\\[\\s*\\]\\s*PROGMEM\\s*=\\s*\\{([^}]*)\\}");
+  for (std::sregex_iterator i(source.begin(), source.end(), arrayPattern), end; i != end; ++i) {
+    vector<long> numbers = parseNumbers((*i)[2]);
+    arrays[(*i)[1]] = vector<int16_t>(numbers.begin(), numbers.end());
+  }
+  string table = findTable(source, "pulseTrainArray");
+  std::regex entryPattern("\\{\\s*\"(\\w+)\"\\s*,[^,]*,\\s*\\(int16_t\\s*\\*\\)\\s*&?(\\w+)(?:\\s*,\\s*\\{[^}]*\\})?\\s*\\}");
+  for (std::sregex_iterator i(table.begin(), table.end(), entryPattern), end; i != end; ++i) {
+    if (arrays.find((*i)[2]) == arrays.end()) {
+      fprintf(stderr, "pulse train %s used by %s not found\n", (*i)[2].str().c_str(), (*i)[1].str().c_str());
+      return false;
+    }
+    library.storage.push_back(arrays[(*i)[2]]);
+    PulseTrainStruct item = PulseTrainStruct();
+    strncpy(item.key, (*i)[1].str().c_str(), sizeof item.key - 1);
+    library.pulseTrains.push_back(item);
+  }
+  // the pointers are set once the storage has stopped growing
+  for (size_t i = 0; i < library.pulseTrains.size(); i++) {
+    library.pulseTrains[i].pulseTrainSize = library.storage[i].size();
+    library.pulseTrains[i].pulseTrain = &library.storage[i][0];
+  }
+  std::map<string, vector<uint8_t> > bitArrays;
+  std::regex bitArrayPattern("const\\s+uint8_t\\s+(\\w+)\\s*\\[\\s*\\]\\s*PROGMEM\\s*=\\s*\\{([^}]*)\\}");
+  for (std::sregex_iterator i(source.begin(), source.end(), bitArrayPattern), end; i != end; ++i) {
+    vector<long> numbers = parseNumbers((*i)[2]);
+    bitArrays[(*i)[1]] = vector<uint8_t>(numbers.begin(), numbers.end());
+  }
+  table = findTable(source, "pwmPulseTrains");
+  std::regex pwmPattern("\\{\\s*\"(\\w+)\"\\s*,\\s*(-?\\d+)\\s*,\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,\\s*(?:\\(\\s*(?:const\\s+)?uint8_t\\s*\\*\\s*\\))?\\s*&?(\\w+)(?:\\s*,\\s*\\{[^}]*\\})?\\s*\\}");
+  for (std::sregex_iterator i(table.begin(), table.end(), pwmPattern), end; i != end; ++i) {
+    if (bitArrays.find((*i)[6]) == bitArrays.end()) {
+      fprintf(stderr, "bits %s used by %s not found\n", (*i)[6].str().c_str(), (*i)[1].str().c_str());
+      return false;
+    }
+    PwmPulseTrainStruct item = PwmPulseTrainStruct();
+    strncpy(item.key, (*i)[1].str().c_str(), sizeof item.key - 1);
+    item.syncGap = atoi((*i)[2].str().c_str());
+    item.shortPulse = atoi((*i)[3].str().c_str());
+    item.longPulse = atoi((*i)[4].str().c_str());
+    item.bitCount = atoi((*i)[5].str().c_str());
+    vector<uint8_t> bits = bitArrays[(*i)[6]];
+    bits.resize((item.bitCount + 7) / 8);
+    library.pwmStorage.push_back(bits);
+    library.pwmPulseTrains.push_back(item);
+  }
+  for (size_t i = 0; i < library.pwmPulseTrains.size(); i++) {
+    library.pwmPulseTrains[i].bits = &library.pwmStorage[i][0];
+  }
+  return !library.pulseTrains.empty() || !library.pwmPulseTrains.empty();
+}
+
+// The result of classifying one line of a log file
+struct Capture {
+  size_t offset; // offset of the line in the log file
+  unsigned int timestampLength; // 0 if the line has no timestamp
+  bool found;
+  MatchResult match;
+  uint64_t signature; // cluster signature of an unknown pulse train
+};
+
+// The captures classified by one thread
+struct Chunk {
+  const char *start;
+  const char *end;
+  size_t lineCount;
+  vector<Capture> captures;
+  vector<size_t> lines; // line number within the chunk of each capture
+};
+
+// Rounds a pulse so that the same signal received with a little jitter has the same value
+static int16_t roundPulse(int16_t pulse) {
+  int step = abs(pulse) < 1000 ? 50 : 200;
+  int rounded = ((abs(pulse) + step / 2) / step) * step;
+  return pulse < 0 ? -rounded : rounded;
+}
+
+/*
+  Finds the last repeat of a pulse train, the pulses after the last sync gap (ignoring the radio silence)
+  @first out parameter, index of the first pulse of the last repeat
+  @return the number of pulses in the last repeat
+*/
+static int lastRepeat(const vector<int16_t> &pulses, int &first) {
+  int end = pulses.size() - 1;
+  first = 0;
+  for (int i = end - 1; i > 0; i--) {
+    if (abs(pulses[i]) >= SYNC_GAP_MIN_DURATION) {
+      first = i;
+      break;
+    }
+  }
+  return end - first;
+}
+
+// FNV-1a hash of the rounded last repeat
+static uint64_t clusterSignature(const vector<int16_t> &pulses) {
+  uint64_t hash = 14695981039346656037ULL;
+  int first;
+  int count = lastRepeat(pulses, first);
+  for (int i = first + 1; i < first + count; i++) {
+    uint16_t value = roundPulse(pulses[i]);
+    hash = (hash ^ (value & 0xFF)) * 1099511628211ULL;
+    hash = (hash ^ (value >> 8)) * 1099511628211ULL;
+  }
+  return hash ^ count;
+}
+
+// Parses the pulses of a line, stopping at the first 0 as Receiver::getPulseTrain does
+static bool parsePulses(const char *p, const char *end, vector<int16_t> &pulses) {
+  pulses.clear();
+  while (p < end) {
+    while (p < end && (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r')) p++;
+    if (p >= end) break;
+    bool negative = *p == '-';
+    if (negative) p++;
+    if (p >= end || *p < '0' || *p > '9') return false;
+    long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+    if (value == 0) break;
+    if (value > INT16_MAX) value = INT16_MAX;
+    pulses.push_back(negative ? -value : value);
+  }
+  // only the last SAMPLESIZE pulses fit in the receiver's buffer
+  if (pulses.size() > SAMPLESIZE) pulses.erase(pulses.begin(), pulses.end() - SAMPLESIZE);
+  return !pulses.empty();
+}
+
+// Classifies the lines of a chunk of a log file
+static void classifyChunk(Chunk &chunk, const Library *library, bool trie, bool drift) {
+  PulseTrainManager *manager = library ?
+      new PulseTrainManager(library->pulseTrains.empty() ? NULL : &library->pulseTrains[0], library->pulseTrains.size(),
+                            library->pwmPulseTrains.empty() ? NULL : &library->pwmPulseTrains[0], library->pwmPulseTrains.size()) :
+      new PulseTrainManager();
+  if (drift) manager->setDriftTolerant(true);
+  vector<int16_t> pulses;
+  pulses.reserve(SAMPLESIZE);
+  const char *line = chunk.start;
+  chunk.lineCount = 0;
+  while (line < chunk.end) {
+    const char *lineEnd = (const char *)memchr(line, '\n', chunk.end - line);
+    if (!lineEnd) lineEnd = chunk.end;
+    const char *p = line;
+    while (p < lineEnd && (*p == ' ' || *p == '\t')) p++;
+    if (p < lineEnd && *p != '#' && *p != '\r') {
+      Capture capture = Capture();
+      capture.offset = line - chunk.start;
+      // the timestamp is everything before the first space or tab
+      const char *separator = p;
+      while (separator < lineEnd && *separator != ' ' && *separator != '\t') separator++;
+      if (separator < lineEnd) {
+        capture.timestampLength = separator - line;
+        p = separator;
+      }
+      if (parsePulses(p, lineEnd, pulses)) {
+        capture.found = trie ? manager->findPulseTrainTrie(&pulses, &capture.match)
+                             : manager->findPulseTrain(&pulses, &capture.match);
+        if (!capture.found) capture.signature = clusterSignature(pulses);
+        chunk.captures.push_back(capture);
+        chunk.lines.push_back(chunk.lineCount);
+      }
+    }
+    chunk.lineCount++;
+    line = lineEnd + 1;
+  }
+  delete manager;
+}
+
+// A cluster of unknown pulse trains
+struct Cluster {
+  uint64_t signature;
+  size_t count;
+  string first; // timestamp of the first and last pulse trains in the cluster
+  string last;
+  string example; // line of the first pulse train in the cluster
+  int id;
+};
+
+static bool byCount(const Cluster *a, const Cluster *b) {
+  return a->count != b->count ? a->count > b->count : a->signature < b->signature;
+}
+
+int main(int argc, char *argv[]) {
+  const char *libraryPath = NULL;
+  unsigned int threadCount = std::thread::hardware_concurrency();
+  bool trie = false;
+  bool drift = false;
+  size_t clusterCount = 20;
+  int opt;
+  while ((opt = getopt(argc, argv, "l:j:tdc:")) != -1) {
+    switch (opt) {
+      case 'l': libraryPath = optarg; break;
+      case 'j': threadCount = atoi(optarg); break;
+      case 't': trie = true; break;
+      case 'd': drift = true; break;
+      case 'c': clusterCount = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-l ProgMemGlobals.cpp] [-j threads] [-t] [-d] [-c clusters] log files...\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "Usage: %s [-l ProgMemGlobals.cpp] [-j threads] [-t] [-d] [-c clusters] log files...\n", argv[0]);
+    return 2;
+  }
+  if (threadCount < 1) threadCount = 1;
+  Library library;
+  if (libraryPath) {
+    if (trie) fprintf(stderr, "-t ignored, the prefix trie layout only exists for the built in library\n");
+    trie = false;
+    if (!loadLibrary(libraryPath, library)) {
+      fprintf(stderr, "no pulse trains loaded from %s\n", libraryPath);
+      return 1;
+    }
+  }
+
+  std::map<uint64_t, Cluster> clusters;
+  size_t captureCount = 0;
+  size_t matchCount = 0;
+  std::map<string, size_t> keyCounts;
+  for (int f = optind; f < argc; f++) {
+    int fd = open(argv[f], O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      fprintf(stderr, "can't open %s\n", argv[f]);
+      return 1;
+    }
+    if (info.st_size == 0) {
+      close(fd);
+      continue;
+    }
+    const char *data = (const char *)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      fprintf(stderr, "can't map %s\n", argv[f]);
+      return 1;
+    }
+    madvise((void *)data, info.st_size, MADV_SEQUENTIAL);
+    const char *dataEnd = data + info.st_size;
+
+    // split the file into a chunk per thread at line boundaries
+    vector<Chunk> chunks(threadCount);
+    const char *start = data;
+    for (unsigned int t = 0; t < threadCount; t++) {
+      const char *end = t + 1 == threadCount ? dataEnd : data + (info.st_size * (t + 1)) / threadCount;
+      if (end < start) end = start;
+      while (end < dataEnd && end > data && end[-1] != '\n') end++;
+      chunks[t].start = start;
+      chunks[t].end = end;
+      start = end;
+    }
+    vector<std::thread> threads;
+    for (unsigned int t = 0; t < threadCount; t++) {
+      threads.push_back(std::thread(classifyChunk, std::ref(chunks[t]), libraryPath ? &library : NULL, trie, drift));
+    }
+    for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+
+    // cluster the unknown pulse trains in file order so the results don't depend on the number of threads
+    size_t lineBase = 0;
+    vector<std::pair<Capture *, size_t> > ordered;
+    for (size_t t = 0; t < chunks.size(); t++) {
+      for (size_t i = 0; i < chunks[t].captures.size(); i++) {
+        Capture &capture = chunks[t].captures[i];
+        capture.offset += chunks[t].start - data;
+        ordered.push_back(std::make_pair(&capture, lineBase + chunks[t].lines[i] + 1));
+      }
+      lineBase += chunks[t].lineCount;
+    }
+    for (size_t i = 0; i < ordered.size(); i++) {
+      Capture &capture = *ordered[i].first;
+      if (capture.found) continue;
+      string timestamp = capture.timestampLength ? string(data + capture.offset, capture.timestampLength)
+                                                 : std::to_string(ordered[i].second);
+      Cluster &cluster = clusters[capture.signature];
+      if (cluster.count++ == 0) {
+        cluster.signature = capture.signature;
+        cluster.first = timestamp;
+        cluster.id = clusters.size();
+        const char *lineEnd = (const char *)memchr(data + capture.offset, '\n', dataEnd - (data + capture.offset));
+        cluster.example = string(data + capture.offset, lineEnd ? lineEnd : dataEnd);
+      }
+      cluster.last = timestamp;
+    }
+    // write the log
+    for (size_t i = 0; i < ordered.size(); i++) {
+      const Capture &capture = *ordered[i].first;
+      if (capture.timestampLength) {
+        fwrite(data + capture.offset, 1, capture.timestampLength, stdout);
+      } else {
+        printf("%zu", ordered[i].second);
+      }
+      if (capture.found) {
+        printf("\t%s\t%d\t%d\n", capture.match.key, capture.match.confidence, capture.match.margin);
+        matchCount++;
+        keyCounts[capture.match.key]++;
+      } else {
+        printf("\t?C%d\t0\t0\n", clusters[capture.signature].id);
+      }
+    }
+    captureCount += ordered.size();
+    munmap((void *)data, info.st_size);
+    close(fd);
+  }
+
+  fprintf(stderr, "%zu pulse trains, %zu matched, %zu unknown in %zu clusters\n",
+          captureCount, matchCount, captureCount - matchCount, clusters.size());
+  for (std::map<string, size_t>::const_iterator i = keyCounts.begin(); i != keyCounts.end(); ++i) {
+    fprintf(stderr, "  %-6s %zu\n", i->first.c_str(), i->second);
+  }
+  vector<Cluster *> sorted;
+  for (std::map<uint64_t, Cluster>::iterator i = clusters.begin(); i != clusters.end(); ++i) sorted.push_back(&i->second);
+  std::sort(sorted.begin(), sorted.end(), byCount);
+  for (size_t i = 0; i < sorted.size() && i < clusterCount; i++) {
+    fprintf(stderr, "?C%d count: %zu first: %s last: %s\n  %s\n", sorted[i]->id, sorted[i]->count,
+            sorted[i]->first.c_str(), sorted[i]->last.c_str(), sorted[i]->example.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+/*
+  File: Arduino.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Host build stand-in for the parts of the Arduino core used by the firmware classes
+  Allows PulseTrainManager, Receiver and ProgMemGlobals to be compiled unmodified on a PC
+  for the benchmark and other host tools. Pin and interrupt functions do nothing,
+  micros() and millis() are based on the host's clock and Serial writes to stdout.
+*/
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stddef.h>
+
+#ifndef F_CPU
+  #define F_CPU 16000000UL // the firmware targets a 16MHz ATmega328P
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define LED_BUILTIN 13
+#define DEC 10
+#define HEX 16
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define _BV(bit) (1 << (bit))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+inline int digitalPinToInterrupt(int pin) { return pin == 2 ? 0 : (pin == 3 ? 1 : -1); }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+inline void interrupts() {}
+inline void noInterrupts() {}
+extern uint8_t SREG;
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+/*
+  Minimal version of the Arduino Print class, only the overloads used by the firmware are provided
+*/
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual int availableForWrite() { return 0; }
+    size_t write(const char *str) { size_t n = 0; while (*str) n += write((uint8_t)*str++); return n; }
+    size_t print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+    size_t print(const char *str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+/*
+  Serial port stand-in, output goes to stdout and input comes from stdin (when used)
+*/
+class HardwareSerial : public Print
+{
+  public:
+    void begin(unsigned long) {}
+    int available();
+    int read();
+    void flush();
+    size_t write(uint8_t c);
+    int availableForWrite() { return 64; }
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+#endif
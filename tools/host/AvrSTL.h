@@ -0,0 +1,11 @@
+/*
+  File: AvrSTL.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Host build stand-in for the AvrSTL library, the host compiler's own STL is used instead
+*/
+#ifndef AvrSTL_h
+#define AvrSTL_h
+
+#endif
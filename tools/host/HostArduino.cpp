@@ -0,0 +1,84 @@
+/*
+  File: HostArduino.cpp
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Host build implementation of the Arduino core functions declared in the stand-in Arduino.h
+*/
+#include "Arduino.h"
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+HardwareSerial &sout = Serial; // the firmware's alias for the Serial class
+uint8_t SREG = 0;
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+/*
+  The clock starts at one second rather than zero, the firmware uses a zero millis() value
+  to mean 'not set' (eg. Receiver::endTime) which on the hardware is never reached after setup()
+*/
+unsigned long micros() {
+  return 1000000UL + (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long millis() {
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+size_t Print::print(long n, int base) {
+  if (base != DEC) return print((unsigned long)n, base);
+  char buffer[24];
+  snprintf(buffer, sizeof buffer, "%ld", n);
+  return write(buffer);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char buffer[24];
+  snprintf(buffer, sizeof buffer, base == HEX ? "%lX" : "%lu", n);
+  return write(buffer);
+}
+
+size_t Print::print(double n, int digits) {
+  char buffer[32];
+  snprintf(buffer, sizeof buffer, "%.*f", digits, n);
+  return write(buffer);
+}
+
+int HardwareSerial::available() {
+  return 0;
+}
+
+int HardwareSerial::read() {
+  return -1;
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return putchar(c) == EOF ? 0 : 1;
+}
+
+long random(long howbig) {
+  return howbig == 0 ? 0 : rand() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  srand(seed);
+}
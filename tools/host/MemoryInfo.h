@@ -0,0 +1,25 @@
+/*
+  File: MemoryInfo.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Host build stand-in for the MemoryInfo library, there is no AVR memory layout to report on the host
+*/
+#ifndef MemoryInfo_h
+#define MemoryInfo_h
+
+namespace MemoryInfo {
+  inline int dataStart() { return 0; }
+  inline int dataSize() { return 0; }
+  inline int heapStart() { return 0; }
+  inline int heapEnd() { return 0; }
+  inline int heapSize() { return 0; }
+  inline int heapFree() { return 0; }
+  inline int heapAvailable() { return 0; }
+  inline int stackPointer() { return 0; }
+  inline int stackSize() { return 0; }
+  inline int stackAvailable() { return 0; }
+  inline int ramEnd() { return 0; }
+}
+
+#endif
@@ -0,0 +1,28 @@
+/*
+  File: Streaming.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Host build stand-in for the Streaming library (<< operator for the Print class)
+*/
+#ifndef Streaming_h
+#define Streaming_h
+
+#include "Arduino.h"
+
+template <typename T>
+inline Print &operator <<(Print &stream, T arg) { stream.print(arg); return stream; }
+
+struct _BASED {
+  long val;
+  int base;
+  _BASED(long v, int b) : val(v), base(b) {}
+};
+#define _HEX(a) _BASED(a, HEX)
+#define _DEC(a) _BASED(a, DEC)
+inline Print &operator <<(Print &stream, const _BASED &arg) { stream.print(arg.val, arg.base); return stream; }
+
+enum _EndLineCode { endl };
+inline Print &operator <<(Print &stream, _EndLineCode) { stream.println(); return stream; }
+
+#endif
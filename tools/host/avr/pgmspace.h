@@ -0,0 +1,28 @@
+/*
+  File: avr/pgmspace.h
+  Author: Chris Claxton 2018
+  Copyright (c) 2018 Chris Claxton subject to the GNU GPLv3 licence
+
+  Host build stand-in for avr-libc's program memory functions
+  There is no separate program memory on the host, so progmem reads are plain memory reads
+*/
+#ifndef pgmspace_h
+#define pgmspace_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+inline uint8_t pgm_read_byte_near(const void *address) { uint8_t value; memcpy(&value, address, sizeof value); return value; }
+inline uint16_t pgm_read_word_near(const void *address) { uint16_t value; memcpy(&value, address, sizeof value); return value; }
+inline uint32_t pgm_read_dword_near(const void *address) { uint32_t value; memcpy(&value, address, sizeof value); return value; }
+#define pgm_read_byte(address) pgm_read_byte_near(address)
+#define pgm_read_word(address) pgm_read_word_near(address)
+#define pgm_read_dword(address) pgm_read_dword_near(address)
+#define pgm_read_ptr(address) (*(void * const *)(address))
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+
+#endif